@@ -32,6 +32,7 @@ struct acceptor : net::socket_base
     void *this_;
     void (*implementation)(void * this_, socket *,
                            boost::cobalt::completion_handler<error_code>);
+    constexpr static void (*try_implementation)(void * this_, socket *, boost::cobalt::handler<error_code>) = nullptr;
 
     op_awaitable<accept_op, std::tuple<socket *>, error_code>
         operator co_await()
@@ -52,6 +53,7 @@ struct acceptor : net::socket_base
     void *this_;
     void (*implementation)(void * this_, wait_type wt,
                            boost::cobalt::completion_handler<error_code>);
+    constexpr static void (*try_implementation)(void * this_, wait_type, boost::cobalt::handler<error_code>) = nullptr;
 
     op_awaitable<wait_op, std::tuple<wait_type>, error_code>
         operator co_await()
@@ -0,0 +1,89 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef COBALT_IO_BLOCKING_POOL_HPP
+#define COBALT_IO_BLOCKING_POOL_HPP
+
+#include <cobalt/io/buffer.hpp>
+#include <cobalt/io/config.hpp>
+
+#include <boost/asio/append.hpp>
+#include <boost/asio/execution_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/prefer.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/cobalt/op.hpp>
+
+#include <cstdint>
+#include <tuple>
+
+namespace cobalt::io
+{
+
+/// A bounded set of threads per execution context, that runs calls which block regardless of readiness,
+/// e.g. page faults or fsync, so they don't stall the executor.
+/// The thread count can be set with `net::make_service<blocking_pool>(ctx, n)` before the first use.
+struct blocking_pool final : net::execution_context::service
+{
+  COBALT_IO_DECL static net::execution_context::id id;
+
+  COBALT_IO_DECL explicit blocking_pool(net::execution_context & ctx, std::size_t threads = 4u);
+  COBALT_IO_DECL static blocking_pool & get(const executor & exec = this_thread::get_executor());
+
+  /// Run `work` on the pool & complete `handler` with the tuple it returns on `exec`.
+  /// Running work can't be cancelled.
+  template<typename Work, typename Handler>
+  void post(const executor & exec, Work work, Handler handler)
+  {
+    // keeps the handler's context from running out of work in the meantime.
+    auto tracked = net::prefer(exec, net::execution::outstanding_work.tracked);
+    net::post(
+        pool_,
+        [work = std::move(work), tracked = std::move(tracked), handler = std::move(handler)]() mutable
+        {
+          std::apply([&](auto && ... args)
+                     {
+                       net::post(tracked, net::append(std::move(handler), std::move(args)...));
+                     }, work());
+        });
+  }
+
+  template<typename Work, typename ... Ts>
+  void post(Work work, completion_handler<Ts...> handler)
+  {
+    const auto exec = handler.get_executor();
+    post(exec, std::move(work), std::move(handler));
+  }
+
+ private:
+  COBALT_IO_DECL void shutdown() override;
+  net::thread_pool pool_;
+};
+
+/// Blocking file I/O on the blocking_pool, for when the reactor can't do it asynchronously.
+/// The sequential versions use & advance the file position, so only one of them may run at a time.
+COBALT_IO_DECL void blocking_read_some    (int fd,                   mutable_buffer_sequence seq, completion_handler<error_code, std::size_t> handler);
+COBALT_IO_DECL void blocking_write_some   (int fd,                   const_buffer_sequence seq,   completion_handler<error_code, std::size_t> handler);
+COBALT_IO_DECL void blocking_read_some_at (int fd, std::uint64_t offset, mutable_buffer_sequence seq, completion_handler<error_code, std::size_t> handler);
+COBALT_IO_DECL void blocking_write_some_at(int fd, std::uint64_t offset, const_buffer_sequence seq,   completion_handler<error_code, std::size_t> handler);
+
+namespace detail
+{
+
+COBALT_IO_DECL std::tuple<error_code, std::size_t> read_some_at(int fd, std::uint64_t offset, mutable_buffer_sequence seq);
+
+}
+
+/// The same for any asio handler, which gets completed on `exec`. A bound cancellation slot is ignored.
+template<typename Handler>
+void blocking_read_some_at(const executor & exec, int fd, std::uint64_t offset, mutable_buffer_sequence seq, Handler handler)
+{
+  blocking_pool::get(exec).post(exec, [fd, offset, seq] {return detail::read_some_at(fd, offset, seq);}, std::move(handler));
+}
+
+}
+
+#endif //COBALT_IO_BLOCKING_POOL_HPP
@@ -0,0 +1,216 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef COBALT_IO_CONNECTION_POOL_HPP
+#define COBALT_IO_CONNECTION_POOL_HPP
+
+#include <cobalt/io/ops.hpp>
+#include <cobalt/io/ssl.hpp>
+#include <cobalt/io/stream_socket.hpp>
+
+#include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/ip/basic_resolver.hpp>
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+namespace cobalt::io
+{
+
+/// A pool of client connections, keyed by (host, service, TLS context).
+/// Idle connections get checked for liveness before they're handed out, new ones get
+/// connected with Happy Eyeballs & handshaken if a TLS context is given.
+/// Everything needs to run on the same executor. Connections that outlive the pool just get closed,
+/// pending acquires fail with `operation_aborted` when it's destroyed.
+struct connection_pool
+{
+ private:
+  struct entry_;
+  struct bucket_
+  {
+    std::vector<std::unique_ptr<entry_>> idle; // oldest first, handed out from the back
+    std::size_t count = 0u, acquiring = 0u;
+  };
+  using key_type = std::tuple<std::string, std::string, net::ssl::context *>;
+  using buckets_type = std::map<key_type, bucket_, std::less<>>;
+
+ public:
+  /// A leased connection. It goes back into the pool when destroyed, unless it's closed or discarded.
+  struct connection
+  {
+    connection() = default;
+    COBALT_IO_DECL connection(connection && lhs) noexcept;
+    COBALT_IO_DECL connection& operator=(connection && lhs) noexcept;
+    COBALT_IO_DECL ~connection();
+
+    explicit operator bool() const {return entry_ != nullptr;}
+
+    /// The underlying stream, only one of them is set.
+    COBALT_IO_DECL stream_socket * tcp();
+    COBALT_IO_DECL ssl_stream * ssl();
+    COBALT_IO_DECL io::socket & socket();
+
+    COBALT_IO_DECL write_op write_some(const_buffer_sequence buffer);
+    COBALT_IO_DECL read_op read_some(mutable_buffer_sequence buffer);
+
+    /// Close the connection instead of returning it, e.g. after a protocol error.
+    COBALT_IO_DECL void discard();
+
+   private:
+    friend connection_pool;
+    connection(connection_pool * pool, std::unique_ptr<entry_> entry)
+        : pool_(pool), alive_(pool->alive_), entry_(std::move(entry)) {}
+
+    bool returnable_() const {return pool_ && entry_ && *alive_;}
+
+    connection_pool * pool_ = nullptr;
+    std::shared_ptr<const bool> alive_;
+    std::unique_ptr<entry_> entry_;
+  };
+
+  struct [[nodiscard]] acquire_op
+  {
+    std::string_view host, service;
+    net::ssl::context * tls;
+    std::chrono::steady_clock::duration timeout;
+
+    void *this_;
+    void (*implementation)(void * this_, std::string_view, std::string_view, net::ssl::context *,
+                           std::chrono::steady_clock::duration,
+                           boost::cobalt::completion_handler<error_code, connection>);
+
+    constexpr static void (*try_implementation)(void * this_, std::string_view, std::string_view, net::ssl::context *,
+                                                std::chrono::steady_clock::duration,
+                                                boost::cobalt::handler<error_code, connection>) = nullptr;
+
+    op_awaitable<acquire_op,
+                 std::tuple<std::string_view, std::string_view, net::ssl::context *, std::chrono::steady_clock::duration>,
+                 error_code, connection>
+        operator co_await()
+    {
+      return {this, host, service, tls, timeout};
+    }
+  };
+
+  COBALT_IO_DECL connection_pool(std::size_t max_per_key = 8u,
+                                 std::size_t max_total = 256u,
+                                 std::chrono::steady_clock::duration max_idle = std::chrono::seconds(60),
+                                 const executor & exec = this_thread::get_executor());
+  connection_pool(connection_pool && ) = delete;
+  COBALT_IO_DECL ~connection_pool();
+
+  /// Get an idle connection, or connect a new one if the caps allow it. Otherwise this waits
+  /// until a connection gets released, and fails with `timed_out` after `timeout`.
+  /// A waiting acquire can be cancelled, which completes it with `operation_aborted`.
+  acquire_op acquire(std::string_view host, std::string_view service,
+                     net::ssl::context * tls = nullptr,
+                     std::chrono::steady_clock::duration timeout = std::chrono::seconds(30))
+  {
+    return {host, service, tls, timeout, this, &initiate_acquire_};
+  }
+
+  /// Close all idle connections.
+  COBALT_IO_DECL void clear_idle();
+
+  /// All connections, leased, idle or connecting.
+  std::size_t size() const {return total_;}
+  COBALT_IO_DECL std::size_t idle() const;
+
+ private:
+  struct entry_
+  {
+    buckets_type::iterator bucket;
+    std::variant<stream_socket, ssl_stream> stream;
+    std::chrono::steady_clock::time_point idle_since;
+
+    io::socket & socket() {return std::visit([](auto & s) -> io::socket & {return s;}, stream);}
+  };
+
+  struct waiter_
+  {
+    buckets_type::iterator bucket;
+    net::basic_waitable_timer<std::chrono::steady_clock, net::wait_traits<std::chrono::steady_clock>, executor> timer;
+    std::optional<completion_handler<error_code>> handler;
+
+    // the handler, detached from its cancellation slot.
+    completion_handler<error_code> take()
+    {
+      auto h = std::move(*handler);
+      handler.reset();
+      net::get_associated_cancellation_slot(h).clear();
+      return h;
+    }
+  };
+
+  struct [[nodiscard]] resolve_op_
+  {
+    std::string_view host, service;
+
+    void *this_;
+    void (*implementation)(void * this_, std::string_view, std::string_view,
+                           boost::cobalt::completion_handler<error_code, endpoint_sequence>);
+    constexpr static void (*try_implementation)(void * this_, std::string_view, std::string_view,
+                                                boost::cobalt::handler<error_code, endpoint_sequence>) = nullptr;
+
+    op_awaitable<resolve_op_, std::tuple<std::string_view, std::string_view>, error_code, endpoint_sequence>
+        operator co_await()
+    {
+      return {this, host, service};
+    }
+  };
+
+  struct [[nodiscard]] step_op_
+  {
+    void * arg;
+
+    void *this_;
+    void (*implementation)(void * this_, void *, boost::cobalt::completion_handler<error_code>);
+    constexpr static void (*try_implementation)(void * this_, void *, boost::cobalt::handler<error_code>) = nullptr;
+
+    op_awaitable<step_op_, std::tuple<void*>, error_code> operator co_await()
+    {
+      return {this, arg};
+    }
+  };
+
+  executor executor_;
+  std::size_t max_per_key_, max_total_, total_ = 0u;
+  std::chrono::steady_clock::duration max_idle_;
+  net::ip::basic_resolver<protocol_type, executor> resolver_;
+  buckets_type buckets_;
+  std::list<std::shared_ptr<waiter_>> waiters_;
+  // cleared on destruction, so connections & suspended acquires don't touch the pool afterwards.
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+
+  std::unique_ptr<entry_> pop_idle_(buckets_type::iterator bucket);
+  bool evict_idle_();
+  void release_(std::unique_ptr<entry_> entry, bool reuse);
+  void close_(std::unique_ptr<entry_> entry);
+  void notify_(buckets_type::iterator bucket);
+  void maybe_erase_(buckets_type::iterator bucket);
+
+  COBALT_IO_DECL static bool healthy_(entry_ & entry);
+  COBALT_IO_DECL static void initiate_acquire_(void *, std::string_view, std::string_view, net::ssl::context *,
+                                               std::chrono::steady_clock::duration,
+                                               boost::cobalt::completion_handler<error_code, connection>);
+  COBALT_IO_DECL static void initiate_resolve_(void *, std::string_view, std::string_view,
+                                               boost::cobalt::completion_handler<error_code, endpoint_sequence>);
+  COBALT_IO_DECL static void initiate_connect_(void *, void *, boost::cobalt::completion_handler<error_code>);
+  COBALT_IO_DECL static void initiate_wait_   (void *, void *, boost::cobalt::completion_handler<error_code>);
+};
+
+}
+
+#endif //COBALT_IO_CONNECTION_POOL_HPP
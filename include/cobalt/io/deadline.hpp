@@ -0,0 +1,155 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef COBALT_IO_DEADLINE_HPP
+#define COBALT_IO_DEADLINE_HPP
+
+#include <cobalt/io/ops.hpp>
+#include <cobalt/io/timer_wheel.hpp>
+
+#include <boost/asio/cancellation_signal.hpp>
+
+#include <chrono>
+
+namespace cobalt::detail::io
+{
+
+template<typename Awaitable>
+struct deadline_awaitable;
+
+// initiates the op with a handler bound to our own signal, which gets emitted by the timer_wheel at the deadline,
+// or forwards the cancellation of the awaiting coroutine.
+template<typename Op, typename Args, typename ... Ts>
+struct deadline_awaitable<cobalt::io::op_awaitable<Op, Args, Ts...>> : cobalt::io::op_awaitable<Op, Args, Ts...>
+{
+  using base_type = cobalt::io::op_awaitable<Op, Args, Ts...>;
+
+  deadline_awaitable(base_type && aw, std::chrono::steady_clock::time_point deadline)
+      : base_type(std::move(aw)), deadline_(deadline) {}
+  deadline_awaitable(deadline_awaitable && lhs) : base_type(std::move(lhs)), deadline_(lhs.deadline_) {}
+
+  template<typename Promise>
+  bool await_suspend(std::coroutine_handle<Promise> h
+#if defined(BOOST_ASIO_ENABLE_HANDLER_TRACKING)
+      , const boost::source_location & loc = BOOST_CURRENT_LOCATION
+#endif
+  ) noexcept
+  {
+    if (deadline_ <= std::chrono::steady_clock::now())
+    {
+      this->result.emplace();
+      std::get<0>(*this->result) = net::error::timed_out;
+      return false;
+    }
+
+    BOOST_TRY
+      {
+        this->completed_immediately = detail::completed_immediately_t::initiating;
+
+#if defined(BOOST_ASIO_ENABLE_HANDLER_TRACKING)
+        completion_handler<Ts...> ch{h, this->result, this->resource, &this->completed_immediately, loc};
+#else
+        completion_handler<Ts...> ch{h, this->result, this->resource, &this->completed_immediately};
+#endif
+        outer_ = ch.cancellation_slot;
+        if (outer_.is_connected())
+          outer_.assign([this](net::cancellation_type ct) {signal_.emit(ct);});
+        ch.cancellation_slot = signal_.slot();
+
+        cobalt::io::timer_wheel::get(ch.get_executor()).schedule(entry_, deadline_, &expired_, this);
+        std::apply([&]<typename ... Args_>(Args_ && ... args_)
+                   {
+                     (*this->op_.implementation)(this->op_.this_, std::forward<Args_>(args_)..., std::move(ch));
+                   }, std::move(this->args));
+
+        if (this->completed_immediately == detail::completed_immediately_t::initiating)
+          this->completed_immediately = detail::completed_immediately_t::no;
+        return this->completed_immediately != detail::completed_immediately_t::yes;
+      }
+      BOOST_CATCH(...)
+      {
+        this->init_ep = std::current_exception();
+        return false;
+      }
+    BOOST_CATCH_END
+  }
+
+  auto await_resume(const boost::cobalt::as_tuple_tag & tag)
+  {
+    done_();
+    return base_type::await_resume(tag);
+  }
+
+  auto await_resume(const boost::cobalt::as_result_tag & tag)
+  {
+    done_();
+    return base_type::await_resume(tag);
+  }
+
+  auto await_resume(const boost::source_location & loc = BOOST_CURRENT_LOCATION)
+  {
+    done_();
+    return base_type::await_resume(loc);
+  }
+
+ private:
+  std::chrono::steady_clock::time_point deadline_;
+  cobalt::io::timer_wheel::entry entry_;
+  net::cancellation_signal signal_;
+  net::cancellation_slot outer_;
+  bool timed_out_ = false;
+
+  static void expired_(void * this_)
+  {
+    auto t = static_cast<deadline_awaitable*>(this_);
+    t->timed_out_ = true;
+    t->signal_.emit(net::cancellation_type::terminal);
+  }
+
+  void done_()
+  {
+    entry_.cancel();
+    if (outer_.is_connected())
+      outer_.clear();
+    if (timed_out_ && this->result && std::get<0>(*this->result) == net::error::operation_aborted)
+      std::get<0>(*this->result) = net::error::timed_out;
+  }
+};
+
+}
+
+namespace cobalt::io
+{
+
+/// An op that gets cancelled when the deadline passes, in which case it fails with `timed_out`.
+/// The deadline goes into the executor's timer_wheel, so there's no timer or race involved.
+template<typename Op>
+struct [[nodiscard]] deadline_op
+{
+  Op op;
+  std::chrono::steady_clock::time_point deadline;
+
+  auto operator co_await()
+  {
+    return cobalt::detail::io::deadline_awaitable<decltype(op.operator co_await())>{op.operator co_await(), deadline};
+  }
+};
+
+template<typename Op>
+deadline_op<Op> with_deadline(Op op, std::chrono::steady_clock::time_point deadline)
+{
+  return {std::move(op), deadline};
+}
+
+template<typename Op, typename Rep, typename Period>
+deadline_op<Op> with_deadline(Op op, const std::chrono::duration<Rep, Period> & timeout)
+{
+  return {std::move(op), std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(timeout)};
+}
+
+}
+
+#endif //COBALT_IO_DEADLINE_HPP
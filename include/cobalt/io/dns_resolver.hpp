@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef COBALT_IO_DNS_RESOLVER_HPP
+#define COBALT_IO_DNS_RESOLVER_HPP
+
+#include <cobalt/io/endpoint.hpp>
+#include <cobalt/io/ops.hpp>
+
+#include <array>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cobalt::io
+{
+
+/// A DNS stub resolver that sends its own queries, instead of running getaddrinfo on asio's resolver thread.
+/// A & AAAA get queried in parallel over UDP, truncated answers get retried over TCP.
+/// Numeric addresses & names from the hosts file complete without suspending.
+/// Names get queried as given, `search`/`domain` & `ndots` from resolv.conf aren't applied,
+/// and the service needs to be a numeric port.
+struct dns_resolver
+{
+  struct config
+  {
+    std::vector<endpoint> nameservers;
+    std::chrono::steady_clock::duration timeout = std::chrono::seconds(5);
+    unsigned attempts = 2u;
+  };
+
+  /// Read the nameservers & the `timeout`/`attempts` options. Defaults to 127.0.0.1 like libc does.
+  COBALT_IO_DECL static config load_config(const char * resolv_conf = "/etc/resolv.conf");
+
+  COBALT_IO_DECL dns_resolver(const cobalt::executor & executor = this_thread::get_executor());
+  COBALT_IO_DECL dns_resolver(config cfg, const cobalt::executor & executor = this_thread::get_executor());
+  dns_resolver(dns_resolver && ) = delete;
+  COBALT_IO_DECL ~dns_resolver();
+
+  /// Replace the static host table.
+  COBALT_IO_DECL result<void> load_hosts(const char * path = "/etc/hosts");
+
+  COBALT_IO_DECL void cancel();
+
+  struct [[nodiscard]] resolve_op
+  {
+    std::string_view host, service;
+
+    void *this_;
+    void (*implementation)(void * this_, std::string_view, std::string_view,
+                           boost::cobalt::completion_handler<error_code, endpoint_sequence>);
+    void (*try_implementation)(void * this_, std::string_view, std::string_view,
+                               boost::cobalt::handler<error_code, endpoint_sequence>);
+
+    op_awaitable<resolve_op, std::tuple<std::string_view, std::string_view>, error_code, endpoint_sequence>
+        operator co_await()
+    {
+      return {this, host, service};
+    }
+  };
+
+  resolve_op resolve(std::string_view host, std::string_view service)
+  {
+    return {host, service, this, &initiate_resolve_, &try_resolve_};
+  }
+
+ private:
+  struct query_;
+  struct host_address
+  {
+    int family;
+    std::array<std::uint8_t, 16u> bytes;
+  };
+
+  cobalt::executor executor_;
+  config config_;
+  std::unordered_map<std::string, std::vector<host_address>> hosts_;
+  std::list<std::weak_ptr<query_>> queries_;
+
+  COBALT_IO_DECL static void try_resolve_(void *, std::string_view, std::string_view,
+                                          boost::cobalt::handler<error_code, endpoint_sequence>);
+  COBALT_IO_DECL static void initiate_resolve_(void *, std::string_view, std::string_view,
+                                               boost::cobalt::completion_handler<error_code, endpoint_sequence>);
+};
+
+}
+
+#endif //COBALT_IO_DNS_RESOLVER_HPP
@@ -17,13 +17,12 @@
 #include <boost/system/result.hpp>
 #include <boost/url/static_url.hpp>
 
-#if defined(BOOST_COBALT_NO_PMR)
-#include <boost/container/pmr/vector.hpp>
-#else
-#include <vector>
-#endif
+#include <boost/container/small_vector.hpp>
 
+#include <cstring>
+#include <functional>
 #include <span>
+#include <string_view>
 
 namespace cobalt::detail
 {
@@ -32,6 +31,253 @@ COBALT_IO_DECL BOOST_NORETURN void
 throw_bad_endpoint_access(
     boost::source_location const& loc);
 
+// constexpr parsers & formatters for ip literals, these don't depend on the socket library.
+
+constexpr int hex_digit(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+/// Dotted decimal, like inet_pton no leading zeros are allowed.
+constexpr bool parse_ipv4(std::string_view sv, std::span<std::uint8_t, 4u> out)
+{
+  std::size_t i = 0u;
+  for (std::size_t part = 0u; part < 4u; part++)
+  {
+    if (part > 0u && (i == sv.size() || sv[i++] != '.'))
+      return false;
+
+    const auto begin = i;
+    unsigned value = 0u;
+    while (i < sv.size() && sv[i] >= '0' && sv[i] <= '9' && (i - begin) < 3u)
+      value = value * 10u + static_cast<unsigned>(sv[i++] - '0');
+
+    const auto digits = i - begin;
+    if (digits == 0u || value > 255u || (digits > 1u && sv[begin] == '0'))
+      return false;
+    out[part] = static_cast<std::uint8_t>(value);
+  }
+  return i == sv.size();
+}
+
+/// RFC 4291 text form, including `::` & a trailing dotted quad.
+constexpr bool parse_ipv6(std::string_view sv, std::span<std::uint8_t, 16u> out)
+{
+  std::uint16_t groups[8] = {};
+  std::size_t n = 0u, i = 0u;
+  std::ptrdiff_t gap = -1;
+
+  if (sv.starts_with("::"))
+  {
+    gap = 0;
+    i = 2u;
+  }
+  else if (sv.starts_with(":"))
+    return false;
+
+  while (i < sv.size())
+  {
+    if (n == 8u)
+      return false;
+
+    const auto begin = i;
+    unsigned value = 0u;
+    while (i < sv.size() && hex_digit(sv[i]) >= 0 && (i - begin) < 5u)
+      value = value * 16u + static_cast<unsigned>(hex_digit(sv[i++]));
+
+    if (i < sv.size() && sv[i] == '.')
+    {
+      std::uint8_t v4[4] = {};
+      if (n > 6u || !parse_ipv4(sv.substr(begin), v4))
+        return false;
+      groups[n++] = static_cast<std::uint16_t>(v4[0] << 8 | v4[1]);
+      groups[n++] = static_cast<std::uint16_t>(v4[2] << 8 | v4[3]);
+      i = sv.size();
+      break;
+    }
+
+    if (i == begin || (i - begin) > 4u)
+      return false;
+    groups[n++] = static_cast<std::uint16_t>(value);
+
+    if (i == sv.size())
+      break;
+    if (sv[i++] != ':' || i == sv.size())
+      return false;
+    if (sv[i] == ':')
+    {
+      if (gap >= 0)
+        return false;
+      gap = static_cast<std::ptrdiff_t>(n);
+      i++;
+    }
+  }
+
+  if (gap < 0 ? n != 8u : n > 7u)
+    return false;
+
+  const std::size_t tail = gap < 0 ? 0u : n - static_cast<std::size_t>(gap);
+  const std::size_t head = n - tail;
+  for (std::size_t g = 0u; g < 8u; g++)
+  {
+    const std::uint16_t v = g < head ? groups[g] : (g >= 8u - tail ? groups[g - (8u - n)] : 0u);
+    out[g * 2u]      = static_cast<std::uint8_t>(v >> 8);
+    out[g * 2u + 1u] = static_cast<std::uint8_t>(v & 0xFFu);
+  }
+  return true;
+}
+
+constexpr bool parse_port(std::string_view sv, std::uint16_t & port)
+{
+  if (sv.empty() || sv.size() > 5u)
+    return false;
+  unsigned value = 0u;
+  for (auto c : sv)
+  {
+    if (c < '0' || c > '9')
+      return false;
+    value = value * 10u + static_cast<unsigned>(c - '0');
+  }
+  if (value > 0xFFFFu)
+    return false;
+  port = static_cast<std::uint16_t>(value);
+  return true;
+}
+
+struct ip_literal
+{
+  int family = 0;
+  std::uint8_t bytes[16] = {};
+  std::uint16_t port = 0u;
+  /// The ipv6 zone after the `%`, either numeric or an interface name that gets looked up at runtime.
+  std::string_view scope;
+};
+
+/// Split off the `%scope` of an ipv6 address. Returns false if the scope is empty.
+constexpr bool split_ipv6_scope(std::string_view & addr, std::string_view & scope)
+{
+  const auto pct = addr.find('%');
+  if (pct == std::string_view::npos)
+    return true;
+  scope = addr.substr(pct + 1u);
+  addr = addr.substr(0u, pct);
+  return !scope.empty();
+}
+
+/// `1.2.3.4`, `1.2.3.4:80`, `::1`, `fe80::1%eth0` or `[::1]:443`. The port is optional & defaults to 0.
+constexpr bool parse_ip_literal(std::string_view sv, ip_literal & res)
+{
+  std::string_view addr = sv, port;
+  if (sv.starts_with("["))
+  {
+    const auto close = sv.find(']');
+    if (close == std::string_view::npos)
+      return false;
+    addr = sv.substr(1u, close - 1u);
+    const auto rest = sv.substr(close + 1u);
+    if (!rest.empty() && (rest.front() != ':' || !parse_port(rest.substr(1u), res.port)))
+      return false;
+    res.family = AF_INET6;
+    return split_ipv6_scope(addr, res.scope) && parse_ipv6(addr, std::span<std::uint8_t, 16u>(res.bytes));
+  }
+
+  const auto colon = sv.find(':');
+  if (colon != std::string_view::npos && sv.find(':', colon + 1u) == std::string_view::npos)
+  {
+    addr = sv.substr(0u, colon);
+    port = sv.substr(colon + 1u);
+    if (!parse_port(port, res.port))
+      return false;
+  }
+
+  if (parse_ipv4(addr, std::span<std::uint8_t, 4u>(res.bytes, 4u)))
+    res.family = AF_INET;
+  else if (port.empty() && split_ipv6_scope(addr, res.scope) && parse_ipv6(addr, std::span<std::uint8_t, 16u>(res.bytes)))
+    res.family = AF_INET6;
+  else
+    return false;
+  return true;
+}
+
+constexpr char * format_decimal(unsigned value, char * out)
+{
+  if (value >= 100u)
+    *out++ = static_cast<char>('0' + value / 100u);
+  if (value >= 10u)
+    *out++ = static_cast<char>('0' + (value / 10u) % 10u);
+  *out++ = static_cast<char>('0' + value % 10u);
+  return out;
+}
+
+/// Writes at most 15 chars & returns the end.
+constexpr char * format_ipv4(std::span<const std::uint8_t, 4u> in, char * out)
+{
+  for (std::size_t i = 0u; i < 4u; i++)
+  {
+    if (i > 0u)
+      *out++ = '.';
+    out = format_decimal(in[i], out);
+  }
+  return out;
+}
+
+/// RFC 5952, writes at most 45 chars & returns the end. Like inet_ntop, mapped & compatible
+/// ipv4 addresses get written as a dotted quad.
+constexpr char * format_ipv6(std::span<const std::uint8_t, 16u> in, char * out)
+{
+  std::uint16_t words[8] = {};
+  for (std::size_t i = 0u; i < 8u; i++)
+    words[i] = static_cast<std::uint16_t>(in[i * 2u] << 8 | in[i * 2u + 1u]);
+
+  // the longest run of at least two zero groups, the first one if tied.
+  std::size_t best = 8u, best_len = 0u;
+  for (std::size_t i = 0u; i < 8u;)
+  {
+    std::size_t j = i;
+    while (j < 8u && words[j] == 0u)
+      j++;
+    if (j - i > best_len && j - i > 1u)
+    {
+      best = i;
+      best_len = j - i;
+    }
+    i = j == i ? i + 1u : j;
+  }
+
+  constexpr char digits[] = "0123456789abcdef";
+  for (std::size_t i = 0u; i < 8u; i++)
+  {
+    if (i == best)
+    {
+      *out++ = ':';
+      if (i + best_len == 8u)
+        *out++ = ':';
+      i += best_len - 1u;
+      continue;
+    }
+    if (i > 0u)
+      *out++ = ':';
+
+    if (i == 6u && best == 0u &&
+        (best_len == 6u || (best_len == 7u && words[7] != 1u) || (best_len == 5u && words[5] == 0xFFFFu)))
+      return format_ipv4(in.subspan<12u, 4u>(), out);
+
+    bool leading = true;
+    for (int shift = 12; shift >= 0; shift -= 4)
+    {
+      const auto d = (words[i] >> shift) & 0xFu;
+      if (leading && d == 0u && shift > 0)
+        continue;
+      leading = false;
+      *out++ = digits[d];
+    }
+  }
+  return out;
+}
+
 }
 
 namespace cobalt::io
@@ -148,8 +394,21 @@ struct endpoint
   }
 
   endpoint() = default;
-  endpoint(const endpoint & ep) : storage_(ep.storage_), size_(ep.size_), protocol_(ep.protocol_), type_(ep.type_)
+  /// From a parsed literal, see `literals::operator""_ep`.
+  COBALT_IO_DECL endpoint(const cobalt::detail::ip_literal & lit);
+  // only copy the part of the storage that's in use, not all of sockaddr_storage.
+  endpoint(const endpoint & ep) : size_(ep.size_), protocol_(ep.protocol_), type_(ep.type_)
   {
+    std::memcpy(&storage_, &ep.storage_, size_);
+  }
+
+  endpoint& operator=(const endpoint & ep)
+  {
+    size_ = ep.size_;
+    protocol_ = ep.protocol_;
+    type_ = ep.type_;
+    std::memmove(&storage_, &ep.storage_, size_);
+    return *this;
   }
 
   template<protocol_type::family_t   Family,
@@ -198,10 +457,20 @@ struct endpoint
 #pragma GCC diagnostic pop
 #endif
 
+/// Compares the address, i.e. family, address, port & scope for ip or the path for local endpoints.
+/// The socket type & protocol are ignored.
+COBALT_IO_DECL bool operator==(const endpoint & lhs, const endpoint & rhs) noexcept;
+
+/// Hashes the same parts that `operator==` compares, never padding or unused storage.
+COBALT_IO_DECL std::size_t hash_value(const endpoint & ep) noexcept;
+
+// most lookups yield one address per family, so these stay inline & don't allocate.
+// Every endpoint keeps a full sockaddr_storage though, so the inline part is about 576 bytes,
+// which a move copies (only `size()` bytes of each endpoint) unless the sequence spilled to the allocator.
 #if defined(BOOST_COBALT_NO_PMR)
-using endpoint_sequence = std::vector<endpoint>;
+using endpoint_sequence = boost::container::small_vector<endpoint, 4u>;
 #else
-using endpoint_sequence = pmr::vector<endpoint>;
+using endpoint_sequence = boost::container::small_vector<endpoint, 4u, pmr::polymorphic_allocator<endpoint>>;
 #endif
 
 
@@ -339,12 +608,41 @@ std::size_t tag_invoke(make_endpoint_tag<AF_UNSPEC>,
                        std::string_view address,
                        std::uint16_t port);
 
+/// `1.2.3.4:80` or `[::1]:443`.
+COBALT_IO_DECL
+std::size_t tag_invoke(make_endpoint_tag<AF_UNSPEC>,
+                       net::detail::socket_addr_type* base,
+                       std::string_view address_and_port);
+
 COBALT_IO_DECL
 const ip_address* tag_invoke(get_endpoint_tag<AF_UNSPEC>,
                                 protocol_type actual,
                                 const endpoint::addr_type * addr);
 
 
+namespace literals
+{
+
+/// An ip endpoint that's parsed at compile time, e.g. `"127.0.0.1:80"_ep` or `"[::1]:443"_ep`.
+consteval cobalt::detail::ip_literal operator""_ep(const char * str, std::size_t size)
+{
+  cobalt::detail::ip_literal lit;
+  if (!cobalt::detail::parse_ip_literal({str, size}, lit))
+    throw "invalid ip endpoint literal";
+  return lit;
+}
+
+}
+
 }
 
+template<>
+struct std::hash<cobalt::io::endpoint>
+{
+  std::size_t operator()(const cobalt::io::endpoint & ep) const noexcept
+  {
+    return cobalt::io::hash_value(ep);
+  }
+};
+
 #endif //BOOST_COBALT_EXPERIMENTAL_IO_ENDPOINT_HPP
\ No newline at end of file
@@ -0,0 +1,211 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef COBALT_IO_ENDPOINT_MAP_HPP
+#define COBALT_IO_ENDPOINT_MAP_HPP
+
+#include <cobalt/io/endpoint.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace cobalt::io
+{
+
+/// An open-addressing hash map keyed by endpoint, with linear probing.
+/// A byte of the hash per slot is kept in a separate array, so probing rarely touches the endpoints.
+/// Inserting & erasing invalidates iterators, the key must not be modified through an iterator.
+template<typename V>
+struct endpoint_map
+{
+  using key_type    = endpoint;
+  using mapped_type = V;
+  using value_type  = std::pair<endpoint, V>;
+
+  template<bool Const>
+  struct basic_iterator
+  {
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = endpoint_map::value_type;
+    using difference_type   = std::ptrdiff_t;
+    using reference         = std::conditional_t<Const, const value_type &, value_type &>;
+    using pointer           = std::conditional_t<Const, const value_type *, value_type *>;
+
+    basic_iterator() = default;
+    template<bool C = Const> requires C
+    basic_iterator(const basic_iterator<false> & it) : map_(it.map_), idx_(it.idx_) {}
+
+    reference operator*()  const {return *map_->slots_[idx_];}
+    pointer   operator->() const {return &*map_->slots_[idx_];}
+
+    basic_iterator & operator++()
+    {
+      idx_ = map_->next_(idx_ + 1u);
+      return *this;
+    }
+    basic_iterator operator++(int)
+    {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+    }
+
+    friend bool operator==(const basic_iterator & lhs, const basic_iterator & rhs) {return lhs.idx_ == rhs.idx_;}
+
+   private:
+    friend endpoint_map;
+    friend basic_iterator<!Const>;
+    using map_type = std::conditional_t<Const, const endpoint_map, endpoint_map>;
+    basic_iterator(map_type * map, std::size_t idx) : map_(map), idx_(idx) {}
+    map_type * map_ = nullptr;
+    std::size_t idx_ = 0u;
+  };
+
+  using iterator       = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+
+  endpoint_map() = default;
+  explicit endpoint_map(std::size_t capacity) { reserve(capacity); }
+
+  iterator       begin()       {return {this, next_(0u)};}
+  const_iterator begin() const {return {this, next_(0u)};}
+  iterator       end()         {return {this, slots_.size()};}
+  const_iterator end()   const {return {this, slots_.size()};}
+
+  std::size_t size()  const {return size_;}
+  bool        empty() const {return size_ == 0u;}
+
+  void clear()
+  {
+    std::fill(tags_.begin(), tags_.end(), std::uint8_t{0u});
+    for (auto & s : slots_)
+      s.reset();
+    size_ = 0u;
+  }
+
+  /// Make room for `n` elements without rehashing.
+  void reserve(std::size_t n)
+  {
+    const auto needed = std::bit_ceil(std::max<std::size_t>(8u, n + n / 3u + 1u));
+    if (needed > slots_.size())
+      rehash_(needed);
+  }
+
+  iterator find(const endpoint & ep)
+  {
+    return {this, find_(ep)};
+  }
+  const_iterator find(const endpoint & ep) const
+  {
+    return {this, find_(ep)};
+  }
+  bool contains(const endpoint & ep) const {return find_(ep) != slots_.size();}
+
+  template<typename ... Args>
+  std::pair<iterator, bool> try_emplace(const endpoint & ep, Args && ... args)
+  {
+    if (auto idx = find_(ep); idx != slots_.size())
+      return {iterator{this, idx}, false};
+
+    reserve(size_ + 1u);
+    const auto h = hash_value(ep);
+    auto idx = h & mask_();
+    while (tags_[idx] != 0u)
+      idx = (idx + 1u) & mask_();
+
+    tags_[idx] = tag_(h);
+    slots_[idx].emplace(std::piecewise_construct,
+                        std::forward_as_tuple(ep),
+                        std::forward_as_tuple(std::forward<Args>(args)...));
+    size_++;
+    return {iterator{this, idx}, true};
+  }
+
+  V & operator[](const endpoint & ep)
+  {
+    return try_emplace(ep).first->second;
+  }
+
+  /// Erase with backward shifting, so no tombstones are left behind.
+  std::size_t erase(const endpoint & ep)
+  {
+    auto idx = find_(ep);
+    if (idx == slots_.size())
+      return 0u;
+
+    for (auto nx = (idx + 1u) & mask_(); tags_[nx] != 0u; nx = (nx + 1u) & mask_())
+    {
+      const auto ideal = hash_value(slots_[nx]->first) & mask_();
+      // only move elements whose ideal slot isn't between the hole & their current slot.
+      if (((nx - ideal) & mask_()) >= ((nx - idx) & mask_()))
+      {
+        tags_[idx]  = tags_[nx];
+        slots_[idx] = std::move(slots_[nx]);
+        idx = nx;
+      }
+    }
+
+    tags_[idx] = 0u;
+    slots_[idx].reset();
+    size_--;
+    return 1u;
+  }
+
+ private:
+  std::vector<std::uint8_t> tags_; // 0 = empty, otherwise 0x80 | 7 bits of the hash.
+  std::vector<std::optional<value_type>> slots_;
+  std::size_t size_ = 0u;
+
+  std::size_t mask_() const {return slots_.size() - 1u;}
+  static std::uint8_t tag_(std::size_t h) {return static_cast<std::uint8_t>(0x80u | (h >> (sizeof(std::size_t) * 8u - 7u)));}
+
+  std::size_t next_(std::size_t idx) const
+  {
+    while (idx < tags_.size() && tags_[idx] == 0u)
+      idx++;
+    return idx;
+  }
+
+  std::size_t find_(const endpoint & ep) const
+  {
+    if (size_ == 0u)
+      return slots_.size();
+
+    const auto h = hash_value(ep);
+    const auto tag = tag_(h);
+    for (auto idx = h & mask_(); tags_[idx] != 0u; idx = (idx + 1u) & mask_())
+      if (tags_[idx] == tag && slots_[idx]->first == ep)
+        return idx;
+    return slots_.size();
+  }
+
+  void rehash_(std::size_t capacity)
+  {
+    auto old = std::move(slots_);
+    tags_.assign(capacity, 0u);
+    slots_.clear();
+    slots_.resize(capacity);
+
+    for (auto & s : old)
+      if (s)
+      {
+        auto idx = hash_value(s->first) & mask_();
+        while (tags_[idx] != 0u)
+          idx = (idx + 1u) & mask_();
+        tags_[idx] = tag_(hash_value(s->first));
+        slots_[idx] = std::move(s);
+      }
+  }
+};
+
+}
+
+#endif //COBALT_IO_ENDPOINT_MAP_HPP
@@ -11,6 +11,7 @@
 #include <boost/asio/basic_file.hpp>
 
 #include <cobalt/io/config.hpp>
+#include <cobalt/io/ops.hpp>
 #include <boost/system/result.hpp>
 
 #if !defined(BOOST_ASIO_HAS_FILE)
@@ -118,14 +119,44 @@ struct file
   COBALT_IO_DECL result<void> sync_all();
   COBALT_IO_DECL result<void> sync_data();
 
+  /// fsync & fdatasync on the blocking_pool, so the flush doesn't stall the executor. They can't be cancelled.
+  wait_op async_sync_all()  {return {this, initiate_sync_all_};}
+  wait_op async_sync_data() {return {this, initiate_sync_data_};}
+
+  /// The flags of sync_file_range.
+  enum sync_range_flags : unsigned
+  {
+    sync_wait_before = 1u,
+    sync_write       = 2u,
+    sync_wait_after  = 4u
+  };
+
+  friend sync_range_flags operator|(sync_range_flags x, sync_range_flags y)
+  {
+    return static_cast<sync_range_flags>(static_cast<unsigned int>(x) | static_cast<unsigned int>(y));
+  }
+
+  /// Write back a range of dirty pages with sync_file_range. `sync_write` alone only starts the write-back,
+  /// so it's cheap enough to call inline. It doesn't flush metadata, so it's no replacement for sync_data.
+  /// A `len` of zero means up to the end of the file. Fails with `operation_not_supported` outside of linux.
+  COBALT_IO_DECL result<void> sync_range(std::uint64_t offset, std::uint64_t len, sync_range_flags flags = sync_write);
+
 #if defined(BOOST_ASIO_HAS_FILE)
   file(net::basic_file<executor> & file) : file_(file) {}
- private:
-  net::basic_file<executor> & file_;
 #else
   explicit file(executor exec) : file_(exec) {}
   file(executor exec, int fd) : file_(exec, fd) {}
+#endif
+
+ private:
+  COBALT_IO_DECL static void initiate_sync_all_ (void *, boost::cobalt::completion_handler<error_code>);
+  COBALT_IO_DECL static void initiate_sync_data_(void *, boost::cobalt::completion_handler<error_code>);
+
+#if defined(BOOST_ASIO_HAS_FILE)
+  net::basic_file<executor> & file_;
+#else
  protected:
+  // only used for the handle, regular files are always ready for the reactor, so reads & writes go to the blocking_pool.
   boost::asio::posix::basic_stream_descriptor<executor> file_;
 #endif
 
@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef COBALT_IO_MAPPED_FILE_HPP
+#define COBALT_IO_MAPPED_FILE_HPP
+
+#include <cobalt/io/buffer.hpp>
+#include <cobalt/io/file.hpp>
+#include <cobalt/io/ops.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace cobalt::io
+{
+
+/// A memory mapping of (a part of) a file, so reads don't need to copy into user buffers.
+/// Touching pages that aren't resident yet faults synchronously, so `prefetch` should be awaited before.
+struct mapped_file
+{
+  enum advice
+  {
+    normal,
+    sequential,
+    random,
+    will_need,
+    dont_need,
+    huge_page
+  };
+
+  constexpr static std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+  COBALT_IO_DECL mapped_file(const cobalt::executor & executor = this_thread::get_executor());
+  /// Map `length` bytes of `f` starting at `offset`, clamped to the end of the file, so npos maps all of it.
+  COBALT_IO_DECL mapped_file(file & f, std::uint64_t offset = 0u, std::size_t length = npos, bool writable = false,
+                             const cobalt::executor & executor = this_thread::get_executor());
+  COBALT_IO_DECL mapped_file(mapped_file && lhs) noexcept;
+  COBALT_IO_DECL mapped_file& operator=(mapped_file && lhs) noexcept;
+  COBALT_IO_DECL ~mapped_file();
+
+  COBALT_IO_DECL result<void> map(file & f, std::uint64_t offset = 0u, std::size_t length = npos, bool writable = false);
+  COBALT_IO_DECL result<void> unmap();
+
+  bool is_mapped() const {return data_ != nullptr;}
+  std::byte * data() const {return data_;}
+  std::size_t size() const {return size_;}
+
+  /// A view of the mapping, clamped to its size.
+  const_buffer   view(std::size_t offset = 0u, std::size_t length = npos) const;
+  mutable_buffer mutable_view(std::size_t offset = 0u, std::size_t length = npos);
+
+  COBALT_IO_DECL result<void> advise(advice adv, std::size_t offset = 0u, std::size_t length = npos);
+  /// Write dirty pages of a writable mapping back, either waiting for it or just scheduling it.
+  COBALT_IO_DECL result<void> flush(bool wait = true);
+
+  struct [[nodiscard]] prefetch_op
+  {
+    std::size_t offset, length;
+
+    void *this_;
+    void (*implementation)(void * this_, std::size_t, std::size_t,
+                           boost::cobalt::completion_handler<error_code>);
+    constexpr static void (*try_implementation)(void * this_, std::size_t, std::size_t,
+                                                boost::cobalt::handler<error_code>) = nullptr;
+
+    op_awaitable<prefetch_op, std::tuple<std::size_t, std::size_t>, error_code> operator co_await()
+    {
+      return {this, offset, length};
+    }
+  };
+
+  /// Read the range in on the blocking_pool & wait until it's resident, so reading it afterwards doesn't block on the disk.
+  /// Fails with `timed_out` if it isn't resident after about 100ms; pages might still get evicted again later.
+  prefetch_op prefetch(std::size_t offset = 0u, std::size_t length = npos)
+  {
+    return {offset, length, this, &initiate_prefetch_};
+  }
+
+ private:
+  executor executor_;
+  std::byte * data_ = nullptr;
+  std::size_t size_ = 0u;
+  // the mapping starts at a page boundary before data_.
+  std::size_t page_offset_ = 0u;
+
+  std::size_t clamp_(std::size_t offset, std::size_t & length) const;
+  COBALT_IO_DECL static void initiate_prefetch_(void *, std::size_t, std::size_t, boost::cobalt::completion_handler<error_code>);
+};
+
+inline std::size_t mapped_file::clamp_(std::size_t offset, std::size_t & length) const
+{
+  offset = (std::min)(offset, size_);
+  length = (std::min)(length, size_ - offset);
+  return offset;
+}
+
+inline const_buffer mapped_file::view(std::size_t offset, std::size_t length) const
+{
+  offset = clamp_(offset, length);
+  return {data_ + offset, length};
+}
+
+inline mutable_buffer mapped_file::mutable_view(std::size_t offset, std::size_t length)
+{
+  offset = clamp_(offset, length);
+  return {data_ + offset, length};
+}
+
+}
+
+#endif //COBALT_IO_MAPPED_FILE_HPP
@@ -0,0 +1,74 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef COBALT_IO_PERIODIC_TIMER_HPP
+#define COBALT_IO_PERIODIC_TIMER_HPP
+
+#include <cobalt/io/ops.hpp>
+#include <cobalt/io/timer_wheel.hpp>
+
+#include <chrono>
+#include <optional>
+
+namespace cobalt::io
+{
+
+/// A timer that ticks at `first + n * period`, so the schedule doesn't drift no matter when the ticks get awaited.
+/// Ticks that passed while nobody was waiting get skipped & reported by the next one.
+/// It's registered with the executor's timer_wheel, so a tick doesn't allocate.
+struct periodic_timer
+{
+  typedef std::chrono::steady_clock clock_type;
+  typedef typename clock_type::duration duration;
+  typedef typename clock_type::time_point time_point;
+
+  COBALT_IO_DECL periodic_timer(const duration & period, const cobalt::executor & executor = this_thread::get_executor());
+  COBALT_IO_DECL periodic_timer(const time_point & first, const duration & period,
+                                const cobalt::executor & executor = this_thread::get_executor());
+  periodic_timer(periodic_timer && ) = delete;
+  COBALT_IO_DECL ~periodic_timer();
+
+  COBALT_IO_DECL void cancel();
+
+  duration period() const {return period_;}
+  /// The time of the upcoming tick.
+  time_point next() const {return next_;}
+  /// Restart the schedule, cancelling a pending tick.
+  COBALT_IO_DECL void reset(const time_point & first, const duration & period);
+
+  struct [[nodiscard]] tick_op
+  {
+    void *this_;
+    void (*implementation)(void * this_, boost::cobalt::completion_handler<error_code, std::size_t>);
+    void (*try_implementation)(void * this_, boost::cobalt::handler<error_code, std::size_t>);
+
+    op_awaitable<tick_op, std::tuple<>, error_code, std::size_t> operator co_await()
+    {
+      return {this};
+    }
+  };
+
+  /// Wait for the next tick, the result is the number of ticks that got missed before it.
+  tick_op tick() {return {this, &initiate_tick_, &try_tick_};}
+
+ private:
+  timer_wheel & wheel_;
+  time_point next_;
+  duration period_;
+  timer_wheel::entry entry_;
+  std::optional<completion_handler<error_code, std::size_t>> handler_;
+
+  std::size_t advance_(time_point now);
+  void complete_(error_code ec, std::size_t missed, bool clear_slot);
+  static void expired_(void * this_);
+
+  COBALT_IO_DECL static void initiate_tick_(void *, boost::cobalt::completion_handler<error_code, std::size_t>);
+  COBALT_IO_DECL static void try_tick_(void *, boost::cobalt::handler<error_code, std::size_t>);
+};
+
+}
+
+#endif //COBALT_IO_PERIODIC_TIMER_HPP
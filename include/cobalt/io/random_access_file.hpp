@@ -17,9 +17,40 @@
 #include <boost/cobalt/noop.hpp>
 #include <boost/cobalt/op.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+
 namespace cobalt::io
 {
 
+/// An allocator with a runtime alignment, e.g. for buffers used with direct I/O.
+template<typename T>
+struct aligned_allocator
+{
+  using value_type = T;
+
+  explicit aligned_allocator(std::size_t alignment = alignof(T)) : alignment((std::max)(alignment, alignof(T))) {}
+  template<typename U>
+  aligned_allocator(const aligned_allocator<U> & lhs) : alignment(lhs.alignment) {}
+
+  T * allocate(std::size_t n)
+  {
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignment)));
+  }
+  void deallocate(T * p, std::size_t n)
+  {
+    ::operator delete(p, n * sizeof(T), std::align_val_t(alignment));
+  }
+
+  template<typename U>
+  friend bool operator==(const aligned_allocator & lhs, const aligned_allocator<U> & rhs) {return lhs.alignment == rhs.alignment;}
+
+  std::size_t alignment;
+};
 
 struct random_access_file : file
 {
@@ -44,10 +75,103 @@ struct random_access_file : file
     return { offset, buffer, this, initiate_read_some_at_};
   }
 
+  using range = std::pair<std::uint64_t, net::mutable_buffer>;
+
+  /// Issues all reads of `ranges` at once & yields their completions in the order they arrive.
+  /// The buffer of each range gets shrunk to what got read into it.
+  ///
+  /// It MUST be drained with `next` until `pending() == 0` before it or the buffers get destroyed:
+  /// the destructor only requests cancellation, which io_uring handles asynchronously,
+  /// so the kernel could still write into the buffers afterwards. Debug builds assert this.
+  struct read_stream
+  {
+    COBALT_IO_DECL read_stream(random_access_file & file, std::span<range> ranges);
+    read_stream(read_stream && ) = delete;
+    COBALT_IO_DECL ~read_stream();
+
+    /// Reads that haven't been yielded by `next` yet.
+    COBALT_IO_DECL std::size_t pending() const;
+    /// Cancel all reads that are still running.
+    COBALT_IO_DECL void cancel();
+
+    struct [[nodiscard]] next_op
+    {
+      void *this_;
+      void (*implementation)(void * this_, boost::cobalt::completion_handler<error_code, std::size_t, std::size_t>);
+      void (*try_implementation)(void * this_, boost::cobalt::handler<error_code, std::size_t, std::size_t>);
+
+      op_awaitable<next_op, std::tuple<>, error_code, std::size_t, std::size_t> operator co_await()
+      {
+        return {this};
+      }
+    };
+
+    /// The next completed read as (error, index into ranges, bytes read). Fails with `not_found` once drained.
+    next_op next() {return {this, &initiate_next_, &try_next_};}
+
+   private:
+    struct stream_state_;
+    std::shared_ptr<stream_state_> state_;
+
+    COBALT_IO_DECL static void initiate_next_(void *, boost::cobalt::completion_handler<error_code, std::size_t, std::size_t>);
+    COBALT_IO_DECL static void try_next_(void *, boost::cobalt::handler<error_code, std::size_t, std::size_t>);
+  };
+
+  struct [[nodiscard]] read_many_op
+  {
+    std::span<range> ranges;
+
+    void *this_;
+    void (*implementation)(void * this_, std::span<range>,
+                           boost::cobalt::completion_handler<error_code, std::size_t>);
+    constexpr static void (*try_implementation)(void * this_, std::span<range>,
+                                                boost::cobalt::handler<error_code, std::size_t>) = nullptr;
+
+    op_awaitable<read_many_op, std::tuple<std::span<range>>, error_code, std::size_t> operator co_await()
+    {
+      return {this, ranges};
+    }
+  };
+
+  /// Read all ranges at once, which completes with the total size once they're all done.
+  /// The first error cancels the remaining reads & gets reported.
+  read_many_op read_many(std::span<range> ranges)
+  {
+    return {ranges, this, &initiate_read_many_};
+  }
+
+  /// Bypass the page cache (O_DIRECT). Offsets, sizes & memory then need to be aligned, as reported by statx.
+  /// Unaligned reads go through a bounce buffer, writes only if just the memory is unaligned,
+  /// otherwise they fail with `invalid_argument`.
+  COBALT_IO_DECL result<void> set_direct_io(bool enable);
+  bool direct_io() const {return direct_;}
+
+  std::size_t memory_alignment() const {return memory_alignment_;}
+  std::size_t offset_alignment() const {return offset_alignment_;}
+  aligned_allocator<std::byte> get_aligned_allocator() const {return aligned_allocator<std::byte>{memory_alignment_};}
+
 
  private:
   COBALT_IO_DECL static void initiate_read_some_at_(void *, std::uint64_t,  mutable_buffer_sequence, boost::cobalt::completion_handler<error_code, std::size_t>);
   COBALT_IO_DECL static void initiate_write_some_at_(void *, std::uint64_t, const_buffer_sequence,   boost::cobalt::completion_handler<error_code, std::size_t>);
+  COBALT_IO_DECL static void initiate_read_many_(void *, std::span<range>, boost::cobalt::completion_handler<error_code, std::size_t>);
+  COBALT_IO_DECL static void initiate_bounce_read_ (void *, std::uint64_t, mutable_buffer_sequence, boost::cobalt::completion_handler<error_code, std::size_t>);
+  COBALT_IO_DECL static void initiate_bounce_write_(void *, std::uint64_t, const_buffer_sequence,   boost::cobalt::completion_handler<error_code, std::size_t>);
+
+  template<typename Sequence>
+  bool aligned_(std::uint64_t offset, const Sequence & seq) const
+  {
+    if (offset % offset_alignment_ != 0u)
+      return false;
+    for (auto itr = seq.begin(); itr != seq.end(); itr++)
+      if (reinterpret_cast<std::uintptr_t>(itr->data()) % memory_alignment_ != 0u ||
+          itr->size() % offset_alignment_ != 0u)
+        return false;
+    return true;
+  }
+
+  bool direct_ = false;
+  std::size_t memory_alignment_ = 1u, offset_alignment_ = 1u;
 #if defined(BOOST_ASIO_HAS_FILE)
   net::basic_random_access_file<executor> implementation_;
 #endif
@@ -19,6 +19,15 @@
 #include <boost/system/result.hpp>
 #include <boost/url/url_view.hpp>
 
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
 namespace cobalt::io
 {
 
@@ -69,6 +78,83 @@ struct lookup
   std::optional<decltype(resolver_.resolve(host_, service_))> op_;
 };
 
+/// A resolver that caches results for `ttl` & failures for `negative_ttl`.
+/// Concurrent lookups of the same (host, service) share one query. Expired results are
+/// still served for up to `stale` longer, while a refresh runs in the background.
+struct caching_resolver
+{
+  caching_resolver(std::chrono::steady_clock::duration ttl          = std::chrono::seconds(30),
+                   std::chrono::steady_clock::duration negative_ttl = std::chrono::seconds(5),
+                   std::chrono::steady_clock::duration stale        = std::chrono::seconds(30),
+                   const cobalt::executor & executor = this_thread::get_executor());
+  caching_resolver(caching_resolver && ) = delete;
+  /// Pending resolves fail with `operation_aborted`, background refreshes get dropped.
+  COBALT_IO_DECL ~caching_resolver();
+
+  void cancel();
+
+  struct [[nodiscard]] resolve_op
+  {
+    std::string_view host, service;
+
+    void *this_;
+    void (*implementation)(void * this_, std::string_view, std::string_view,
+                           boost::cobalt::completion_handler<error_code, endpoint_sequence>);
+    void (*try_implementation)(void * this_, std::string_view, std::string_view,
+                               boost::cobalt::handler<error_code, endpoint_sequence>);
+
+    op_awaitable<resolve_op, std::tuple<std::string_view, std::string_view>, error_code, endpoint_sequence>
+        operator co_await()
+    {
+      return {this, host, service};
+    }
+  };
+
+  /// Concurrent resolves of the same name share one lookup. Cancelling one of them only detaches it,
+  /// the lookup still completes for the others & the cache.
+  resolve_op resolve(std::string_view host, std::string_view service)
+  {
+    return {host, service, this, &initiate_resolve_, &try_resolve_};
+  }
+
+  /// Drop all entries, that aren't currently being looked up.
+  COBALT_IO_DECL void clear();
+  std::size_t size() const {return cache_.size();}
+
+ private:
+  using key_type = std::tuple<std::string, std::string>;
+  // when entries can't be served anymore, so they get dropped without scanning the cache.
+  // Entries that are being looked up aren't in here.
+  using expiry_type = std::multimap<std::chrono::steady_clock::time_point, const key_type *>;
+
+  struct entry_
+  {
+    endpoint_sequence endpoints;
+    error_code error;
+    std::chrono::steady_clock::time_point expires{};
+    bool resolved = false, querying = false;
+    std::optional<expiry_type::iterator> drop;
+    // a list, so a cancelled waiter can remove itself.
+    std::list<completion_handler<error_code, endpoint_sequence>> waiting;
+  };
+  using cache_type = std::map<key_type, entry_, std::less<>>;
+
+  std::chrono::steady_clock::duration ttl_, negative_ttl_, stale_;
+  net::ip::basic_resolver<protocol_type, executor> resolver_;
+  cache_type cache_;
+  expiry_type expiry_;
+  // cleared on destruction, since a lookup might still complete afterwards.
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+
+  void query_(cache_type::iterator itr);
+  void prune_();
+
+  COBALT_IO_DECL static void try_resolve_(void *, std::string_view, std::string_view,
+                                          boost::cobalt::handler<error_code, endpoint_sequence>);
+  COBALT_IO_DECL static void initiate_resolve_(void *, std::string_view, std::string_view,
+                                               boost::cobalt::completion_handler<error_code, endpoint_sequence>);
+};
+
 }
 
 #endif //BOOST_COBALT_EXPERIMENTAL_IO_RESOLVER_HPP
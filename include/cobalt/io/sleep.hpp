@@ -11,21 +11,40 @@
 #include <cobalt/io/ops.hpp>
 #include <cobalt/io/steady_timer.hpp>
 #include <cobalt/io/system_timer.hpp>
+#include <cobalt/io/timer_wheel.hpp>
 
 #include <boost/cobalt/promise.hpp>
 
 namespace cobalt::detail::io
 {
 
+// waits on the executor's timer_wheel directly, so there's no timer to construct & nothing gets allocated.
 struct [[nodiscard]] steady_sleep
 {
-  steady_sleep(const std::chrono::steady_clock::time_point & tp) : tim{tp} {}
-  steady_sleep(const std::chrono::steady_clock::duration & du)   : tim{du} {}
-
-  auto operator co_await() { return std::move(op_.emplace(tim.wait())).operator co_await(); }
+  steady_sleep(const std::chrono::steady_clock::time_point & tp) : expiry_{tp} {}
+  steady_sleep(const std::chrono::steady_clock::duration & du)   : expiry_{std::chrono::steady_clock::now() + du} {}
+
+  auto operator co_await()
+  {
+    op_ = {this, &initiate_, &try_};
+    return op_.operator co_await();
+  }
  private:
-  cobalt::io::steady_timer tim;
-  std::optional<decltype(tim.wait())> op_;
+  std::chrono::steady_clock::time_point expiry_;
+  cobalt::io::timer_wheel::entry entry_;
+  cobalt::io::wait_op op_{nullptr, nullptr};
+
+  static void initiate_(void * this_, boost::cobalt::completion_handler<error_code> handler)
+  {
+    auto s = static_cast<steady_sleep*>(this_);
+    cobalt::io::timer_wheel::get().async_wait(s->entry_, s->expiry_, std::move(handler));
+  }
+
+  static void try_(void * this_, boost::cobalt::handler<error_code> h)
+  {
+    if (static_cast<steady_sleep*>(this_)->expiry_ <= std::chrono::steady_clock::now())
+      h({});
+  }
 };
 
 struct [[nodiscard]] system_sleep
@@ -44,9 +63,7 @@ struct [[nodiscard]] system_sleep
 namespace cobalt::io
 {
 
-
-
-// NOTE: these don't need to be coros, we can optimize that out. Not sure that's worth it though
+/// Steady sleeps go through the timer_wheel, so they get rounded up to its granularity.
 auto sleep(const std::chrono::steady_clock::duration & d)    { return detail::io::steady_sleep{d};}
 auto sleep(const std::chrono::steady_clock::time_point & tp) { return detail::io::steady_sleep{tp};}
 auto sleep(const std::chrono::system_clock::time_point & tp) { return detail::io::system_sleep{tp};}
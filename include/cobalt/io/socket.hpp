@@ -13,6 +13,8 @@
 #include <boost/asio/socket_base.hpp>
 #include <boost/asio/basic_socket.hpp>
 
+#include <chrono>
+
 
 namespace cobalt::io
 {
@@ -147,6 +149,36 @@ struct socket
     return {std::move(ep), this, initiate_ranged_connect_};
   }
 
+  /// Happy Eyeballs v2 (RFC 8305): alternate the address families & start the next attempt
+  /// every `attempt_delay` or as soon as one fails, whichever comes first. The first to connect wins.
+  struct happy_eyeballs
+  {
+    std::chrono::steady_clock::duration attempt_delay = std::chrono::milliseconds(250);
+  };
+
+  struct [[nodiscard]] happy_eyeballs_connect_op
+  {
+    endpoint_sequence endpoints;
+    happy_eyeballs options;
+
+    void *this_;
+    void (*implementation)(void * this_, endpoint_sequence, happy_eyeballs,
+                           boost::cobalt::completion_handler<error_code, endpoint>);
+
+    constexpr static void (*try_implementation)(void * this_, endpoint_sequence, happy_eyeballs,
+                                                boost::cobalt::handler<error_code, endpoint>) = nullptr;
+
+    op_awaitable<happy_eyeballs_connect_op, std::tuple<endpoint_sequence, happy_eyeballs>, error_code, endpoint>
+        operator co_await()
+    {
+      return {this, std::move(endpoints), options};
+    }
+  };
+  happy_eyeballs_connect_op connect(endpoint_sequence ep, happy_eyeballs options)
+  {
+    return {std::move(ep), options, this, initiate_happy_eyeballs_connect_};
+  }
+
 
 
   socket(net::basic_socket<protocol_type, executor> & socket) : socket_(socket) {}
@@ -161,6 +193,8 @@ struct socket
   COBALT_IO_DECL static void initiate_connect_(void *, endpoint, completion_handler<error_code>);
   COBALT_IO_DECL static void initiate_ranged_connect_(void *, endpoint_sequence,
                                                       completion_handler<error_code, endpoint>);
+  COBALT_IO_DECL static void initiate_happy_eyeballs_connect_(void *, endpoint_sequence, happy_eyeballs,
+                                                              completion_handler<error_code, endpoint>);
 };
 
 COBALT_IO_DECL result<void> connect_pair(protocol_type protocol, socket & socket1, socket & socket2);
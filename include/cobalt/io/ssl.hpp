@@ -12,12 +12,20 @@
 #include <boost/asio/ssl/stream.hpp>
 #include <boost/asio/basic_stream_socket.hpp>
 
+#include <chrono>
+#include <memory>
+#include <optional>
+
 namespace cobalt::io
 {
 
+struct ssl_session_cache;
+
 namespace detail
 {
 
+struct ktls_state;
+
 struct ssl_stream_base
 {
 
@@ -42,6 +50,7 @@ struct ssl_stream_base
 
   COBALT_IO_DECL ssl_stream(net::ssl::context & ctx, const executor & executor = this_thread::get_executor());
   COBALT_IO_DECL ssl_stream(net::ssl::context & ctx, stream_socket && socket);
+  COBALT_IO_DECL ~ssl_stream();
 
   write_op write_some(const_buffer_sequence buffer)
   {
@@ -59,6 +68,7 @@ struct ssl_stream_base
     void *this_;
     void (*implementation)(void * this_, handshake_type,
                            boost::cobalt::completion_handler<error_code>);
+    constexpr static void (*try_implementation)(void * this_, handshake_type, boost::cobalt::handler<error_code>) = nullptr;
 
     op_awaitable<handshake_op, std::tuple<handshake_type>, error_code>
         operator co_await()
@@ -74,6 +84,8 @@ struct ssl_stream_base
     void *this_;
     void (*implementation)(void * this_, handshake_type, const_buffer_sequence,
                            boost::cobalt::completion_handler<error_code, std::size_t>);
+    constexpr static void (*try_implementation)(void * this_, handshake_type, const_buffer_sequence,
+                                                boost::cobalt::handler<error_code, std::size_t>) = nullptr;
     op_awaitable<buffered_handshake_op, std::tuple<handshake_type, const_buffer_sequence>, error_code, std::size_t>
         operator co_await()
     {
@@ -81,6 +93,22 @@ struct ssl_stream_base
     }
   };
 
+  struct [[nodiscard]] detect_handshake_op
+  {
+    handshake_type ht;
+
+    void *this_;
+    void (*implementation)(void * this_, handshake_type,
+                           boost::cobalt::completion_handler<error_code, bool>);
+    constexpr static void (*try_implementation)(void * this_, handshake_type, boost::cobalt::handler<error_code, bool>) = nullptr;
+
+    op_awaitable<detect_handshake_op, std::tuple<handshake_type>, error_code, bool>
+        operator co_await()
+    {
+      return {this, ht};
+    }
+  };
+
   handshake_op handshake(handshake_type ht)
   {
     return {ht, this,  initiate_handshake_};
@@ -91,6 +119,13 @@ struct ssl_stream_base
     return {ht, buffer, this, initiate_buffered_handshake_};
   }
 
+  /// Peek at the first byte the peer sends & do the handshake if it's a TLS record, or stay plain otherwise.
+  /// Nothing gets read, so there's no need to pass the data on. Returns true if the stream got upgraded.
+  detect_handshake_op detect_and_handshake(handshake_type ht = server)
+  {
+    return {ht, this, initiate_detect_handshake_};
+  }
+
   io::wait_op shutdown()
   {
     return {this, initiate_shutdown_};
@@ -100,14 +135,79 @@ struct ssl_stream_base
   bool hybrid_mode() const {return (mode_ & 3) != 0;}
   void  enable_hybrid_mode() {mode_ |=  3;}
   void disable_hybrid_mode() {mode_ &= ~3;}
+
+  /// The largest record TLS allows & one that fits into a single TCP segment.
+  constexpr static std::size_t max_record_size   = 16384u;
+  constexpr static std::size_t small_record_size =  1369u;
+
+  /// Limit how much a single write_some encrypts. Each write_some produces one record,
+  /// a gathered write gets copied into that record instead of writing only the first buffer.
+  void set_record_size(std::size_t size) {record_size_ = (std::min)(size, max_record_size);}
+  std::size_t record_size() const {return record_size_;}
+
+  /// Use small records until `warm_up` bytes have been written, so the peer can start decrypting early,
+  /// and go back to small records after being idle for `idle`.
+  void enable_dynamic_record_sizing(std::size_t warm_up = 1024u * 1024u,
+                                    std::chrono::steady_clock::duration idle = std::chrono::seconds(1))
+  {
+    warm_up_ = warm_up;
+    idle_ = idle;
+  }
+  void disable_dynamic_record_sizing() {warm_up_ = 0u;}
+  bool dynamic_record_sizing() const {return warm_up_ != 0u;}
+
+  /// Let the kernel encrypt written records (kTLS) once the handshake is done, so write_some goes straight
+  /// to the socket & sendfile works. This needs to be called before the handshake and is only available for TLS 1.3.
+  /// Reads still go through OpenSSL, since records might already be buffered by then.
+  /// If the kernel doesn't support it (e.g. no TCP_ULP), the stream just keeps using OpenSSL.
+  ///
+  /// This installs a keylog callback on the context, which forwards to the one installed before.
+  /// Don't call SSL_key_update on an active stream: the kernel holds the keys, so a KeyUpdate,
+  /// including one the peer requests, closes the connection with an internal_error alert instead.
+  [[nodiscard]] COBALT_IO_DECL result<void> enable_ktls();
+  bool ktls_active() const {return (mode_ & 4) != 0;}
+
+  /// Run the handshake's crypto on `worker` (e.g. a thread_pool's executor) instead of the stream's executor,
+  /// so it doesn't block other coroutines. The handshake still completes on the executor of the awaiting coroutine,
+  /// but can't be cancelled while it's running on the worker.
+  void offload_handshake(const executor & worker) {handshake_executor_ = worker;}
+  void disable_handshake_offload() {handshake_executor_.reset();}
+
+  /// Resume a session stored under `key` (e.g. host & port) & store new sessions there.
+  /// This needs to be called before the handshake, servers use ssl_session_cache::attach instead.
+  /// A stream with its own context needs that context to be attached to a cache first.
+  COBALT_IO_DECL void use_session_cache(ssl_session_cache & cache, std::string_view key);
  private:
   int mode_ = 0;
 
+  // per thread, prepared for the session cache.
+  COBALT_IO_DECL static net::ssl::context & default_context_();
+
+  std::optional<executor> handshake_executor_;
+  COBALT_IO_DECL void handshake_completed_(error_code ec);
+
+  std::unique_ptr<detail::ktls_state> ktls_;
+  COBALT_IO_DECL void install_ktls_();
+  COBALT_IO_DECL static int ktls_index_();
+  COBALT_IO_DECL static void ktls_keylog_(const SSL *, const char *);
+  COBALT_IO_DECL static void ktls_message_(int, int, int, const void *, std::size_t, SSL *, void *);
+  COBALT_IO_DECL error_code send_ktls_alert_(unsigned char level, unsigned char description);
+
+  std::size_t record_size_ = max_record_size;
+  std::unique_ptr<unsigned char[]> record_buffer_;
+
+  std::size_t warm_up_ = 0u, bytes_written_ = 0u;
+  std::chrono::steady_clock::duration idle_{};
+  std::chrono::steady_clock::time_point last_write_{};
+
+  COBALT_IO_DECL std::size_t record_limit_();
+
 
   COBALT_IO_DECL static void initiate_read_some_ (void *, mutable_buffer_sequence, boost::cobalt::completion_handler<error_code, std::size_t>);
   COBALT_IO_DECL static void initiate_write_some_(void *, const_buffer_sequence, boost::cobalt::completion_handler<error_code, std::size_t>);
   COBALT_IO_DECL static void initiate_shutdown_(void *, boost::cobalt::completion_handler<error_code>);
   COBALT_IO_DECL static void initiate_handshake_(void *, handshake_type, boost::cobalt::completion_handler<error_code>);
+  COBALT_IO_DECL static void initiate_detect_handshake_(void *, handshake_type, boost::cobalt::completion_handler<error_code, bool>);
   COBALT_IO_DECL static void initiate_buffered_handshake_(void *, handshake_type, const_buffer_sequence,
                                                              boost::cobalt::completion_handler<error_code, std::size_t>);
 
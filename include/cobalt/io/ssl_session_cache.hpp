@@ -0,0 +1,91 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BOOST_COBALT_EXPERIMENTAL_IO_SSL_SESSION_CACHE_HPP
+#define BOOST_COBALT_EXPERIMENTAL_IO_SSL_SESSION_CACHE_HPP
+
+#include <cobalt/io/config.hpp>
+#include <boost/asio/ssl/context.hpp>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace cobalt::io
+{
+
+struct ssl_stream;
+
+/// A bounded cache of TLS sessions, sharded so it can be shared between threads.
+/// Clients store sessions by a key like `host:port`, see `ssl_stream::use_session_cache`.
+/// Servers attach it to a context, which resumes by session id & encrypts tickets with rotating keys.
+/// Destroying it detaches it from its contexts, so they & the streams bound to it stop using it.
+/// That's not synchronized with handshakes running on other threads though.
+struct ssl_session_cache
+{
+  COBALT_IO_DECL explicit ssl_session_cache(std::size_t capacity = 4096u,
+                                            std::size_t shards = 16u,
+                                            std::chrono::seconds ticket_key_lifetime = std::chrono::hours(1));
+  COBALT_IO_DECL ~ssl_session_cache();
+  ssl_session_cache(const ssl_session_cache & ) = delete;
+
+  /// Use the cache for sessions of a context. Server contexts resume by session id from the cache,
+  /// client contexts need this before their streams can `use_session_cache`; the default client context is prepared already.
+  /// It replaces the context's session callbacks, so it should be done before the context is shared between threads.
+  COBALT_IO_DECL void attach(net::ssl::context & ctx);
+
+  /// Replace the ticket key. Tickets of the previous key still get accepted, but renewed.
+  COBALT_IO_DECL void rotate_ticket_keys();
+
+  /// Store a session, without taking ownership of the passed reference. Returns false if it can't be resumed.
+  COBALT_IO_DECL bool insert(std::string_view key, SSL_SESSION * session);
+  /// Find a session, the returned reference is owned by the caller.
+  COBALT_IO_DECL SSL_SESSION * find(std::string_view key);
+  COBALT_IO_DECL void erase(std::string_view key);
+  COBALT_IO_DECL void clear();
+  COBALT_IO_DECL std::size_t size() const;
+
+ private:
+  friend struct ssl_stream;
+  struct shard_;
+  struct ticket_key_
+  {
+    unsigned char name[16];
+    unsigned char aes_key[32];
+    unsigned char hmac_key[32];
+    std::chrono::steady_clock::time_point created;
+  };
+
+  static void make_ticket_key_(ticket_key_ & key);
+  shard_ & shard_for_(std::string_view key) const;
+  void bind_(SSL * ssl, std::string_view key);
+  static void prepare_client_(SSL_CTX * ctx);
+
+  std::size_t shard_count_, shard_capacity_;
+  std::unique_ptr<shard_[]> shards_;
+
+  // contexts that were attached, with a reference each.
+  std::vector<SSL_CTX*> attached_;
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+
+  std::chrono::seconds ticket_key_lifetime_;
+  std::mutex ticket_mutex_;
+  ticket_key_ current_key_, previous_key_;
+
+  static int new_session_(SSL *, SSL_SESSION *);
+  static SSL_SESSION * get_session_(SSL *, const unsigned char *, int, int *);
+  static void remove_session_(SSL_CTX *, SSL_SESSION *);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  static int ticket_key_callback_(SSL *, unsigned char *, unsigned char *, EVP_CIPHER_CTX *, EVP_MAC_CTX *, int);
+#endif
+};
+
+}
+
+#endif //BOOST_COBALT_EXPERIMENTAL_IO_SSL_SESSION_CACHE_HPP
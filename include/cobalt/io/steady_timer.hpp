@@ -10,10 +10,13 @@
 
 #include <boost/cobalt/op.hpp>
 #include <cobalt/io/ops.hpp>
+#include <cobalt/io/timer_wheel.hpp>
 #include <boost/asio/basic_waitable_timer.hpp>
 
 #include <boost/system/result.hpp>
 
+#include <optional>
+
 namespace cobalt::io
 {
 
@@ -34,6 +37,12 @@ struct steady_timer
   steady_timer(const time_point& expiry_time, const cobalt::executor & executor = this_thread::get_executor());
   steady_timer(const duration& expiry_time,   const cobalt::executor & executor = this_thread::get_executor());
 
+  /// Use the timing wheel instead of asio's timer queue, which makes waiting & cancelling O(1).
+  /// Only one wait can be pending at a time, a new one or a reset cancels the previous.
+  explicit steady_timer(timer_wheel & wheel);
+  steady_timer(const time_point& expiry_time, timer_wheel & wheel);
+  steady_timer(const duration& expiry_time,   timer_wheel & wheel);
+
   void cancel();
 
   time_point expiry() const;
@@ -41,15 +50,24 @@ struct steady_timer
   void reset(const duration& expiry_time);
   bool expired() const;
 
+  /// Allow following resets to fire up to `slack` late, so expiries of many timers land on the same point & get handled in one wakeup.
+  void set_slack(const duration& slack) {slack_ = slack;}
+  duration slack() const {return slack_;}
+
   [[nodiscard]] wait_op wait() { return {this, initiate_wait_, try_wait_}; }
  private:
 
   COBALT_IO_DECL static void initiate_wait_(void *, boost::cobalt::completion_handler<error_code>);
   COBALT_IO_DECL static void try_wait_(void *, boost::cobalt::handler<error_code>);
 
-  net::basic_waitable_timer<std::chrono::steady_clock,
-                                    net::wait_traits<std::chrono::steady_clock>,
-                                    executor> timer_;
+  // not created when the timer uses a wheel.
+  std::optional<net::basic_waitable_timer<std::chrono::steady_clock,
+                                          net::wait_traits<std::chrono::steady_clock>,
+                                          executor>> timer_;
+  timer_wheel * wheel_ = nullptr;
+  time_point wheel_expiry_;
+  duration slack_{0};
+  timer_wheel::entry entry_;
 };
 
 }
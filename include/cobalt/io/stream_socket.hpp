@@ -14,6 +14,8 @@
 #include <boost/asio/generic/datagram_protocol.hpp>
 #include <boost/asio/basic_stream_socket.hpp>
 
+#include <memory>
+
 namespace cobalt::io
 {
 
@@ -27,22 +29,42 @@ struct [[nodiscard]] stream_socket final : socket
   COBALT_IO_DECL stream_socket(endpoint ep,
                   const cobalt::executor & executor = this_thread::get_executor());
 
+  COBALT_IO_DECL ~stream_socket();
+
   write_op write_some(const_buffer_sequence buffer)
   {
-    return {buffer, this, initiate_write_some_};
+    return {buffer, this, initiate_write_some_, try_write_some_};
   }
   read_op read_some(mutable_buffer_sequence buffer)
   {
     return {buffer, this, initiate_read_some_};
   }
 
+  /// Coalesce writes. While corked, write_some copies into an internal buffer of up to `limit` bytes
+  /// and completes immediately. The buffer gets written with one gathered write once the coroutine
+  /// suspends on anything else, or when a write doesn't fit anymore.
+  COBALT_IO_DECL void cork(std::size_t limit = 65536u);
+  COBALT_IO_DECL bool corked() const;
+
+  /// Stop coalescing & write out everything that's been buffered.
+  write_op uncork()
+  {
+    return {{}, this, initiate_uncork_};
+  }
+
  public:
   COBALT_IO_DECL void adopt_endpoint_(endpoint & ep) override;
 
+  COBALT_IO_DECL static void try_write_some_(void *, const_buffer_sequence, boost::cobalt::handler<error_code, std::size_t>);
+  COBALT_IO_DECL static void initiate_uncork_(void *, const_buffer_sequence, boost::cobalt::completion_handler<error_code, std::size_t>);
+
   COBALT_IO_DECL static void initiate_read_some_ (void *, mutable_buffer_sequence, boost::cobalt::completion_handler<error_code, std::size_t>);
   COBALT_IO_DECL static void initiate_write_some_(void *, const_buffer_sequence, boost::cobalt::completion_handler<error_code, std::size_t>);
 
   net::basic_stream_socket<protocol_type, executor> stream_socket_;
+
+  struct cork_state_;
+  std::shared_ptr<cork_state_> cork_;
 };
 
 
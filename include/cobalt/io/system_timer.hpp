@@ -12,6 +12,10 @@
 #include <cobalt/io/ops.hpp>
 #include <boost/asio/basic_waitable_timer.hpp>
 
+#if defined(__linux__)
+#include <boost/asio/posix/basic_stream_descriptor.hpp>
+#endif
+
 #include <boost/system/result.hpp>
 
 namespace cobalt::io
@@ -36,6 +40,16 @@ struct system_timer final
   system_timer(const duration& expiry_time,
                const cobalt::executor & executor = this_thread::get_executor());
 
+  /// Wait on a timerfd with an absolute CLOCK_REALTIME deadline, so the wakeup follows the wall-clock even if it gets set.
+  /// When the clock gets set, a pending wait completes with `net::error::interrupted` & the expiry stays as it is.
+  /// Without timerfd support (i.e. not on linux) this is a regular system_timer.
+  struct use_timerfd_t {};
+  constexpr static use_timerfd_t use_timerfd{};
+
+  system_timer(use_timerfd_t, const cobalt::executor & executor = this_thread::get_executor());
+  system_timer(use_timerfd_t, const time_point& expiry_time,
+               const cobalt::executor & executor = this_thread::get_executor());
+
   void cancel();
 
   time_point expiry() const;
@@ -50,6 +64,10 @@ struct system_timer final
   net::basic_waitable_timer<std::chrono::system_clock,
                                     net::wait_traits<std::chrono::system_clock>,
                                     executor> timer_;
+#if defined(__linux__)
+  std::optional<net::posix::basic_stream_descriptor<executor>> fd_;
+  time_point expiry_;
+#endif
 };
 
 }
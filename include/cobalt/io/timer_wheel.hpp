@@ -0,0 +1,132 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef COBALT_IO_TIMER_WHEEL_HPP
+#define COBALT_IO_TIMER_WHEEL_HPP
+
+#include <cobalt/io/ops.hpp>
+
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/execution_context.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+namespace cobalt::io
+{
+
+/// A hierarchical timing wheel, as a service of the execution context.
+/// Inserting & cancelling a timer is O(1), expiries get rounded up to the granularity.
+/// All pending timers share a single asio timer that's armed for the next occupied slot.
+/// It must only be used from a single thread, like the rest of cobalt.
+struct timer_wheel final : net::execution_context::service
+{
+  typedef std::chrono::steady_clock clock_type;
+  typedef typename clock_type::duration duration;
+  typedef typename clock_type::time_point time_point;
+
+  /// The storage of one pending wait, owned by the timer using the wheel.
+  struct entry
+  {
+    entry() = default;
+    /// Moving an entry cancels the wait pending on it.
+    entry(entry && lhs) noexcept { lhs.cancel(); }
+    entry& operator=(entry && lhs) noexcept
+    {
+      cancel();
+      lhs.cancel();
+      return *this;
+    }
+    ~entry() { cancel(); }
+
+    bool pending() const {return wheel_ != nullptr;}
+    std::size_t cancel() {return wheel_ ? wheel_->cancel(*this) : 0u;}
+
+   private:
+    friend timer_wheel;
+    entry * prev_ = nullptr, * next_ = nullptr;
+    timer_wheel * wheel_ = nullptr;
+    std::uint64_t tick_ = 0u;
+    std::uint32_t slot_ = 0u;
+    std::optional<completion_handler<error_code>> handler_;
+    void (*callback_)(void *) = nullptr;
+    void * arg_ = nullptr;
+  };
+
+  COBALT_IO_DECL static net::execution_context::id id;
+
+  COBALT_IO_DECL explicit timer_wheel(net::execution_context & ctx);
+  COBALT_IO_DECL ~timer_wheel();
+
+  /// Get the wheel of the executor's context.
+  COBALT_IO_DECL static timer_wheel & get(const executor & exec = this_thread::get_executor());
+
+  /// The executor the waits complete on. A wheel of an io_context has one from the start,
+  /// one made by `use_service` for any other context only after it's been obtained through `get`.
+  COBALT_IO_DECL executor get_executor() const;
+
+  duration granularity() const {return granularity_;}
+  /// Change the tick length, which only works while no timer is pending. Defaults to 1ms.
+  COBALT_IO_DECL bool set_granularity(duration tick);
+
+  /// Read the time with CLOCK_MONOTONIC_COARSE, which is cheaper but lags by up to one kernel tick.
+  /// Waits still never fire early, but they may fire up to that much late.
+  void set_coarse(bool coarse) {coarse_ = coarse;}
+  bool coarse() const {return coarse_;}
+  /// The current time, as used by the wheel.
+  COBALT_IO_DECL time_point now() const;
+
+  /// The number of pending waits.
+  std::size_t size() const {return size_;}
+
+  /// Complete `handler` once `expiry` has passed. The entry must not have a wait pending.
+  COBALT_IO_DECL void async_wait(entry & e, time_point expiry, completion_handler<error_code> handler);
+  /// Invoke `fn(arg)` from within the wheel once `expiry` has passed. It doesn't get invoked when cancelled.
+  COBALT_IO_DECL void schedule(entry & e, time_point expiry, void (*fn)(void *), void * arg);
+  /// Cancel the wait pending on `e`, which completes with `operation_aborted`.
+  COBALT_IO_DECL std::size_t cancel(entry & e);
+
+ private:
+  constexpr static std::uint32_t slot_bits = 6u;
+  constexpr static std::uint32_t slots = 1u << slot_bits;
+  constexpr static std::uint32_t levels = 6u;
+  // entries that are being fired, so they can still be cancelled from a completion.
+  constexpr static std::uint32_t due_slot = slots * levels;
+
+  COBALT_IO_DECL void shutdown() override;
+
+  std::uint64_t tick_of_(time_point tp) const;
+  std::uint64_t now_tick_() const;
+  void link_(entry & e, std::uint32_t slot);
+  void unlink_(entry & e);
+  void insert_(entry & e, std::uint64_t tick);
+  void add_(entry & e, time_point expiry);
+  std::optional<std::uint64_t> next_tick_() const;
+  void advance_(std::uint64_t target);
+  void arm_();
+  void fire_(entry & e, error_code ec);
+
+  duration granularity_ = std::chrono::milliseconds(1);
+  time_point start_ = clock_type::now();
+  std::uint64_t current_ = 0u;
+  std::size_t size_ = 0u;
+  bool coarse_ = false;
+
+  std::array<entry*, slots * levels + 1u> heads_{};
+  std::array<std::uint64_t, levels> occupied_{};
+
+  std::optional<net::basic_waitable_timer<clock_type, net::wait_traits<clock_type>, executor>> timer_;
+  std::optional<std::uint64_t> armed_;
+  // cleared on destruction, so the per thread lookup cache doesn't hand out a wheel of a destroyed context.
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+};
+
+}
+
+#endif //COBALT_IO_TIMER_WHEEL_HPP
@@ -0,0 +1,70 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef COBALT_IO_WRITE_QUEUE_HPP
+#define COBALT_IO_WRITE_QUEUE_HPP
+
+#include <cobalt/io/ops.hpp>
+
+#include <list>
+#include <optional>
+#include <vector>
+
+namespace cobalt::io
+{
+
+/// A queue that lets multiple coroutines write to the same stream.
+/// Messages get copied into the queue in order, and are drained by a single writer (`run`),
+/// which writes everything queued up in one go. Everything needs to run on the same executor.
+struct write_queue
+{
+  /// Enqueue a message. Completes when it's copied, which waits if the queue is over the high-water mark.
+  /// A waiting message can be cancelled, in which case nothing of it gets written.
+  write_op write_some(const_buffer_sequence buffers)
+  {
+    return {buffers, this, &initiate_write_some_, &try_write_some_};
+  }
+
+  /// The writer, this drains the queue until it's closed & empty or an error occurs.
+  /// Cancelling it while it waits for messages completes it with `operation_aborted`, after which it can be restarted.
+  write_op run()
+  {
+    return {{}, this, &initiate_run_};
+  }
+
+  /// Don't take new messages & let `run` complete once everything is written.
+  COBALT_IO_DECL void close();
+
+  std::size_t queued() const {return pending_.size() + in_flight_.size();}
+  std::size_t high_water_mark() const {return high_water_mark_;}
+
+  write_queue(write_op op, std::size_t high_water_mark = 65536u)
+      : op_(std::move(op)), high_water_mark_(high_water_mark) {}
+
+ private:
+  write_op op_;
+  std::size_t high_water_mark_;
+  bool closed_ = false;
+  error_code error_;
+
+  std::vector<unsigned char> pending_, in_flight_;
+  std::list<std::pair<const_buffer_sequence, completion_handler<error_code, std::size_t>>> waiting_;
+  std::optional<completion_handler<error_code, std::size_t>> writer_;
+
+  bool fits_(std::size_t n) const {return queued() == 0u || (queued() + n) <= high_water_mark_;}
+  void push_(const_buffer_sequence buffers);
+  void wake_();
+  void admit_();
+
+  COBALT_IO_DECL static void try_write_some_     (void *, const_buffer_sequence, boost::cobalt::handler<error_code, std::size_t>);
+  COBALT_IO_DECL static void initiate_write_some_(void *, const_buffer_sequence, boost::cobalt::completion_handler<error_code, std::size_t>);
+  COBALT_IO_DECL static void initiate_run_       (void *, const_buffer_sequence, boost::cobalt::completion_handler<error_code, std::size_t>);
+  COBALT_IO_DECL static void initiate_wait_      (void *, const_buffer_sequence, boost::cobalt::completion_handler<error_code, std::size_t>);
+};
+
+}
+
+#endif //COBALT_IO_WRITE_QUEUE_HPP
@@ -0,0 +1,105 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <cobalt/io/blocking_pool.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace cobalt::io
+{
+
+net::execution_context::id blocking_pool::id;
+
+blocking_pool::blocking_pool(net::execution_context & ctx, std::size_t threads)
+    : net::execution_context::service(ctx), pool_(threads)
+{
+}
+
+blocking_pool & blocking_pool::get(const executor & exec)
+{
+  return net::use_service<blocking_pool>(net::query(exec, net::execution::context));
+}
+
+void blocking_pool::shutdown()
+{
+  pool_.stop();
+  pool_.join();
+}
+
+namespace
+{
+
+template<typename Sequence>
+std::vector<iovec> to_iovec(const Sequence & seq)
+{
+  std::vector<iovec> iov;
+  iov.reserve(seq.buffer_count());
+  for (auto itr = seq.begin(); itr != seq.end() && iov.size() < IOV_MAX; itr++)
+    iov.push_back(iovec{const_cast<void*>(static_cast<const void*>(itr->data())), itr->size()});
+  return iov;
+}
+
+// a read of zero bytes into a non-empty buffer means the end of the file.
+std::tuple<error_code, std::size_t> io_result(ssize_t n, const std::vector<iovec> & iov, bool read)
+{
+  if (n < 0)
+    return {error_code{errno, ::boost::system::system_category()}, 0u};
+  if (read && n == 0 && std::any_of(iov.begin(), iov.end(), [](const iovec & v) {return v.iov_len > 0u;}))
+    return {net::error::eof, 0u};
+  return {error_code{}, static_cast<std::size_t>(n)};
+}
+
+}
+
+void blocking_read_some(int fd, mutable_buffer_sequence seq, completion_handler<error_code, std::size_t> handler)
+{
+  blocking_pool::get(handler.get_executor()).post(
+      [fd, iov = to_iovec(seq)]
+      {
+        return io_result(::readv(fd, iov.data(), static_cast<int>(iov.size())), iov, true);
+      },
+      std::move(handler));
+}
+
+void blocking_write_some(int fd, const_buffer_sequence seq, completion_handler<error_code, std::size_t> handler)
+{
+  blocking_pool::get(handler.get_executor()).post(
+      [fd, iov = to_iovec(seq)]
+      {
+        return io_result(::writev(fd, iov.data(), static_cast<int>(iov.size())), iov, false);
+      },
+      std::move(handler));
+}
+
+std::tuple<error_code, std::size_t> detail::read_some_at(int fd, std::uint64_t offset, mutable_buffer_sequence seq)
+{
+  const auto iov = to_iovec(seq);
+  return io_result(::preadv(fd, iov.data(), static_cast<int>(iov.size()), static_cast<off_t>(offset)), iov, true);
+}
+
+void blocking_read_some_at(int fd, std::uint64_t offset, mutable_buffer_sequence seq, completion_handler<error_code, std::size_t> handler)
+{
+  const auto exec = handler.get_executor();
+  blocking_read_some_at(exec, fd, offset, seq, std::move(handler));
+}
+
+void blocking_write_some_at(int fd, std::uint64_t offset, const_buffer_sequence seq, completion_handler<error_code, std::size_t> handler)
+{
+  blocking_pool::get(handler.get_executor()).post(
+      [fd, offset, iov = to_iovec(seq)]
+      {
+        return io_result(::pwritev(fd, iov.data(), static_cast<int>(iov.size()), static_cast<off_t>(offset)), iov, false);
+      },
+      std::move(handler));
+}
+
+}
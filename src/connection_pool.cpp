@@ -0,0 +1,363 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <cobalt/io/connection_pool.hpp>
+
+#include <boost/asio/append.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/cobalt/experimental/composition.hpp>
+
+#if !defined(BOOST_ASIO_WINDOWS)
+#include <sys/socket.h>
+#include <cerrno>
+#endif
+
+namespace cobalt::io
+{
+
+connection_pool::connection::connection(connection && lhs) noexcept
+    : pool_(lhs.pool_), alive_(std::move(lhs.alive_)), entry_(std::move(lhs.entry_))
+{
+}
+
+connection_pool::connection& connection_pool::connection::operator=(connection && lhs) noexcept
+{
+  if (this != &lhs)
+  {
+    if (returnable_())
+      pool_->release_(std::move(entry_), true);
+    pool_ = lhs.pool_;
+    alive_ = std::move(lhs.alive_);
+    entry_ = std::move(lhs.entry_);
+  }
+  return *this;
+}
+
+connection_pool::connection::~connection()
+{
+  if (returnable_())
+    pool_->release_(std::move(entry_), true);
+}
+
+stream_socket * connection_pool::connection::tcp() { return std::get_if<stream_socket>(&entry_->stream); }
+ssl_stream    * connection_pool::connection::ssl() { return std::get_if<ssl_stream>(&entry_->stream); }
+io::socket    & connection_pool::connection::socket() { return entry_->socket(); }
+
+write_op connection_pool::connection::write_some(const_buffer_sequence buffer)
+{
+  return std::visit([&](auto & s) {return s.write_some(buffer);}, entry_->stream);
+}
+
+read_op connection_pool::connection::read_some(mutable_buffer_sequence buffer)
+{
+  return std::visit([&](auto & s) {return s.read_some(buffer);}, entry_->stream);
+}
+
+void connection_pool::connection::discard()
+{
+  if (returnable_())
+    pool_->release_(std::move(entry_), false);
+  else
+    entry_.reset();
+}
+
+connection_pool::connection_pool(std::size_t max_per_key,
+                                 std::size_t max_total,
+                                 std::chrono::steady_clock::duration max_idle,
+                                 const executor & exec)
+    : executor_(exec), max_per_key_(max_per_key), max_total_(max_total), max_idle_(max_idle), resolver_(exec)
+{
+}
+
+connection_pool::~connection_pool()
+{
+  *alive_ = false;
+  for (auto & w : waiters_)
+    if (w->handler)
+    {
+      w->timer.cancel();
+      net::post(net::append(w->take(), error_code{net::error::operation_aborted}));
+    }
+}
+
+void connection_pool::clear_idle()
+{
+  for (auto itr = buckets_.begin(); itr != buckets_.end();)
+  {
+    auto & b = itr->second;
+    total_ -= b.idle.size();
+    b.count -= b.idle.size();
+    b.idle.clear();
+    if (b.count == 0u && b.acquiring == 0u)
+      itr = buckets_.erase(itr);
+    else
+      itr++;
+  }
+}
+
+std::size_t connection_pool::idle() const
+{
+  std::size_t n = 0u;
+  for (auto & [_, b] : buckets_)
+    n += b.idle.size();
+  return n;
+}
+
+// a connection that's idle must neither have data nor an EOF pending.
+bool connection_pool::healthy_(entry_ & entry)
+{
+  auto & s = entry.socket();
+  if (!s.is_open())
+    return false;
+
+  auto n = s.bytes_readable();
+  if (!n || *n > 0u)
+    return false;
+
+#if !defined(BOOST_ASIO_WINDOWS)
+  char c;
+  const auto r = ::recv(s.native_handle(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+#else
+  return true;
+#endif
+}
+
+auto connection_pool::pop_idle_(buckets_type::iterator bucket) -> std::unique_ptr<entry_>
+{
+  auto & idle = bucket->second.idle;
+  const auto now = std::chrono::steady_clock::now();
+  while (!idle.empty())
+  {
+    auto e = std::move(idle.back());
+    idle.pop_back();
+    if ((now - e->idle_since) < max_idle_ && healthy_(*e))
+      return e;
+    close_(std::move(e));
+  }
+  return nullptr;
+}
+
+// make room for a new connection by closing the oldest idle one of any key.
+bool connection_pool::evict_idle_()
+{
+  auto oldest = buckets_.end();
+  for (auto itr = buckets_.begin(); itr != buckets_.end(); itr++)
+    if (!itr->second.idle.empty() &&
+        (oldest == buckets_.end() || itr->second.idle.front()->idle_since < oldest->second.idle.front()->idle_since))
+      oldest = itr;
+
+  if (oldest == buckets_.end())
+    return false;
+
+  auto & idle = oldest->second.idle;
+  auto e = std::move(idle.front());
+  idle.erase(idle.begin());
+  close_(std::move(e));
+  return true;
+}
+
+void connection_pool::release_(std::unique_ptr<entry_> entry, bool reuse)
+{
+  if (!reuse || !entry->socket().is_open())
+    return close_(std::move(entry));
+
+  auto bucket = entry->bucket;
+  entry->idle_since = std::chrono::steady_clock::now();
+  bucket->second.idle.push_back(std::move(entry));
+  notify_(bucket);
+}
+
+void connection_pool::close_(std::unique_ptr<entry_> entry)
+{
+  auto bucket = entry->bucket;
+  entry.reset();
+  bucket->second.count--;
+  total_--;
+  notify_(bucket);
+  maybe_erase_(bucket);
+}
+
+// wake the first waiter that can make progress now, i.e. the one waiting for this key,
+// or one that's only held back by the global cap.
+void connection_pool::notify_(buckets_type::iterator bucket)
+{
+  for (auto itr = waiters_.begin(); itr != waiters_.end(); itr++)
+  {
+    auto & w = **itr;
+    if (w.bucket == bucket || w.bucket->second.count < max_per_key_)
+    {
+      auto h = w.take();
+      w.timer.cancel();
+      waiters_.erase(itr);
+      net::post(net::append(std::move(h), error_code{}));
+      return;
+    }
+  }
+}
+
+void connection_pool::maybe_erase_(buckets_type::iterator bucket)
+{
+  auto & b = bucket->second;
+  if (b.count == 0u && b.acquiring == 0u && b.idle.empty())
+    buckets_.erase(bucket);
+}
+
+void connection_pool::initiate_resolve_(void * this_, std::string_view host, std::string_view service,
+                                        boost::cobalt::completion_handler<error_code, endpoint_sequence> handler)
+{
+  auto p = static_cast<connection_pool*>(this_);
+  p->resolver_.async_resolve(
+      cobalt::io::ip, host, service,
+      net::deferred(
+          [](error_code ec, auto rr)
+          {
+#if !defined(BOOST_COBALT_NO_PMR)
+            endpoint_sequence r{this_thread::get_allocator()};
+#else
+            endpoint_sequence r{};
+#endif
+            r.assign(rr.begin(), rr.end());
+            return net::deferred.values(ec, std::move(r));
+          }))(std::move(handler));
+}
+
+void connection_pool::initiate_connect_(void * this_, void * arg,
+                                        boost::cobalt::completion_handler<error_code>)
+{
+  auto p = static_cast<connection_pool*>(this_);
+  auto & e = *static_cast<entry_*>(arg);
+  // copies, the bucket might be gone once this resumes.
+  const auto [host, service, tls] = e.bucket->first;
+  std::shared_ptr<const bool> alive = p->alive_;
+
+  auto [ec, eps] = co_await resolve_op_{host, service, p, &initiate_resolve_};
+  if (!*alive)
+    co_return {net::error::operation_aborted};
+  if (ec)
+    co_return {ec};
+
+  endpoint ep;
+  std::tie(ec, ep) = co_await e.socket().connect(std::move(eps), socket::happy_eyeballs{});
+  if (!*alive)
+    co_return {net::error::operation_aborted};
+  if (ec || !tls)
+    co_return {ec};
+
+  auto & ssl = std::get<ssl_stream>(e.stream);
+  // SNI, and the name the peer's certificate gets verified against.
+  if (!SSL_set_tlsext_host_name(ssl.native_handle(), host.c_str()) || !SSL_set1_host(ssl.native_handle(), host.c_str()))
+    co_return {error_code(static_cast<int>(::ERR_get_error()), net::error::get_ssl_category())};
+
+  std::tie(ec) = co_await ssl.handshake(ssl_stream::client);
+  co_return {ec};
+}
+
+void connection_pool::initiate_wait_(void * this_, void * arg,
+                                     boost::cobalt::completion_handler<error_code> handler)
+{
+  auto p = static_cast<connection_pool*>(this_);
+  auto & [bucket, deadline] = *static_cast<std::pair<buckets_type::iterator, std::chrono::steady_clock::time_point>*>(arg);
+
+  std::shared_ptr<waiter_> w{new waiter_{bucket, decltype(waiter_::timer)(p->executor_), std::move(handler)}};
+  p->waiters_.push_back(w);
+  w->timer.expires_at(deadline);
+  w->timer.async_wait(
+      [p, w](error_code ec)
+      {
+        if (ec || !w->handler)
+          return;
+        auto h = w->take();
+        p->waiters_.remove(w);
+        std::move(h)(net::error::timed_out);
+      });
+
+  // the handler is gone if the waiter got completed or the pool destroyed, so p is valid otherwise.
+  auto slot = net::get_associated_cancellation_slot(*w->handler);
+  if (slot.is_connected())
+    slot.assign(
+        [p, w](net::cancellation_type)
+        {
+          if (!w->handler)
+            return;
+          // not take(), clearing the slot would destroy this handler.
+          auto h = std::move(*w->handler);
+          w->handler.reset();
+          w->timer.cancel();
+          p->waiters_.remove(w);
+          net::post(net::append(std::move(h), error_code{net::error::operation_aborted}));
+        });
+}
+
+void connection_pool::initiate_acquire_(void * this_, std::string_view host, std::string_view service,
+                                        net::ssl::context * tls, std::chrono::steady_clock::duration timeout,
+                                        boost::cobalt::completion_handler<error_code, connection>)
+{
+  auto p = static_cast<connection_pool*>(this_);
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+  auto bucket = p->buckets_.find(std::tuple(host, service, tls));
+  if (bucket == p->buckets_.end())
+    bucket = p->buckets_.emplace(key_type(host, service, tls), bucket_{}).first;
+
+  // keeps the bucket alive while this is suspended.
+  struct acquiring_guard
+  {
+    connection_pool * p;
+    buckets_type::iterator bucket;
+    std::shared_ptr<const bool> alive;
+    acquiring_guard(connection_pool * p, buckets_type::iterator bucket)
+        : p(p), bucket(bucket), alive(p->alive_) {bucket->second.acquiring++;}
+    ~acquiring_guard()
+    {
+      if (!*alive)
+        return;
+      bucket->second.acquiring--;
+      p->maybe_erase_(bucket);
+    }
+  } guard{p, bucket};
+
+  while (true)
+  {
+    if (auto e = p->pop_idle_(bucket))
+      co_return {{}, connection{p, std::move(e)}};
+
+    auto & b = bucket->second;
+    if (b.count < p->max_per_key_ && (p->total_ < p->max_total_ || p->evict_idle_()))
+    {
+      b.count++;
+      p->total_++;
+
+      std::unique_ptr<entry_> e;
+      if (tls)
+        e.reset(new entry_{bucket, std::variant<stream_socket, ssl_stream>(std::in_place_type<ssl_stream>, *tls, p->executor_)});
+      else
+        e.reset(new entry_{bucket, std::variant<stream_socket, ssl_stream>(std::in_place_type<stream_socket>, p->executor_)});
+
+      auto [ec] = co_await step_op_{e.get(), p, &initiate_connect_};
+      if (!*guard.alive)
+        co_return {net::error::operation_aborted, {}};
+      if (ec)
+      {
+        p->close_(std::move(e));
+        co_return {ec, {}};
+      }
+      co_return {{}, connection{p, std::move(e)}};
+    }
+
+    if (std::chrono::steady_clock::now() >= deadline)
+      co_return {net::error::timed_out, {}};
+
+    std::pair<buckets_type::iterator, std::chrono::steady_clock::time_point> args{bucket, deadline};
+    auto [ec] = co_await step_op_{&args, p, &initiate_wait_};
+    if (ec || !*guard.alive)
+      co_return {ec ? ec : error_code{net::error::operation_aborted}, {}};
+  }
+}
+
+}
@@ -0,0 +1,599 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <cobalt/io/dns_resolver.hpp>
+
+#include <boost/asio/basic_datagram_socket.hpp>
+#include <boost/asio/basic_stream_socket.hpp>
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+
+namespace cobalt::io
+{
+
+namespace
+{
+
+using udp_socket = net::basic_datagram_socket<protocol_type, executor>;
+using tcp_socket = net::basic_stream_socket<protocol_type, executor>;
+using timer_type = net::basic_waitable_timer<std::chrono::steady_clock,
+                                             net::wait_traits<std::chrono::steady_clock>,
+                                             executor>;
+
+constexpr std::uint16_t type_a    = 1u;
+constexpr std::uint16_t type_aaaa = 28u;
+
+endpoint make_ip_endpoint(int family, const std::uint8_t * bytes, std::uint16_t port)
+{
+  if (family == AF_INET)
+  {
+    std::uint32_t addr;
+    std::memcpy(&addr, bytes, sizeof(addr));
+    return endpoint(ip_v4, addr, port);
+  }
+
+  std::array<std::uint8_t, 16u> addr;
+  std::copy_n(bytes, addr.size(), addr.begin());
+  return endpoint(ip_v6, std::span<std::uint8_t, 16u>(addr), port);
+}
+
+// numeric addresses, including "[::1]", the scope id gets dropped.
+bool parse_numeric(std::string_view host, int & family, std::array<std::uint8_t, 16u> & bytes)
+{
+  if (host.size() > 2u && host.front() == '[' && host.back() == ']')
+    host = host.substr(1u, host.size() - 2u);
+  host = host.substr(0u, host.find('%'));
+
+  char buf[INET6_ADDRSTRLEN];
+  if (host.empty() || host.size() >= sizeof(buf))
+    return false;
+  *std::copy(host.begin(), host.end(), buf) = '\0';
+
+  if (::inet_pton(AF_INET, buf, bytes.data()) == 1)
+    family = AF_INET;
+  else if (::inet_pton(AF_INET6, buf, bytes.data()) == 1)
+    family = AF_INET6;
+  else
+    return false;
+  return true;
+}
+
+// only numeric ports, getservbyname would read /etc/services on every resolve.
+std::optional<std::uint16_t> parse_port(std::string_view service)
+{
+  std::uint16_t port;
+  auto [ptr, ec] = std::from_chars(service.data(), service.data() + service.size(), port);
+  if (ec == std::errc{} && ptr == service.data() + service.size())
+    return port;
+  return std::nullopt;
+}
+
+std::string lowercase(std::string_view sv)
+{
+  std::string res{sv};
+  for (auto & c : res)
+    if (c >= 'A' && c <= 'Z')
+      c = static_cast<char>(c - 'A' + 'a');
+  if (!res.empty() && res.back() == '.')
+    res.pop_back();
+  return res;
+}
+
+bool encode_query(std::string_view name, std::uint16_t qtype, std::vector<unsigned char> & msg)
+{
+  if (!name.empty() && name.back() == '.')
+    name.remove_suffix(1u);
+  if (name.empty() || name.size() > 253u)
+    return false;
+
+  // id, flags = recursion desired, one question.
+  msg.assign({0u, 0u, 0x01u, 0x00u, 0u, 1u, 0u, 0u, 0u, 0u, 0u, 0u});
+  while (!name.empty())
+  {
+    const auto dot = name.find('.');
+    const auto label = name.substr(0u, dot);
+    if (label.empty() || label.size() > 63u)
+      return false;
+    msg.push_back(static_cast<unsigned char>(label.size()));
+    msg.insert(msg.end(), label.begin(), label.end());
+    name.remove_prefix(dot == std::string_view::npos ? name.size() : dot + 1u);
+  }
+  msg.push_back(0u);
+  msg.insert(msg.end(), {static_cast<unsigned char>(qtype >> 8), static_cast<unsigned char>(qtype & 0xFFu), 0u, 1u});
+  return true;
+}
+
+std::uint16_t read16(const unsigned char * p) { return static_cast<std::uint16_t>(p[0] << 8 | p[1]); }
+
+bool skip_name(const unsigned char *& p, const unsigned char * end)
+{
+  while (p < end)
+  {
+    const auto len = *p;
+    if ((len & 0xC0u) == 0xC0u) // compression pointer, always last.
+    {
+      if (end - p < 2)
+        return false;
+      p += 2;
+      return true;
+    }
+    if (len & 0xC0u)
+      return false;
+    p++;
+    if (len == 0u)
+      return true;
+    if (end - p < len)
+      return false;
+    p += len;
+  }
+  return false;
+}
+
+// the header has been checked for the id & the response bit already.
+error_code parse_response(std::span<const unsigned char> msg, std::uint16_t qtype, std::uint16_t port,
+                          std::vector<endpoint> & out, bool & truncated)
+{
+  const auto flags = read16(msg.data() + 2);
+  truncated = (flags & 0x0200u) != 0u;
+  if (truncated)
+    return {};
+
+  switch (flags & 0x000Fu)
+  {
+    case 0u: break;
+    case 2u: return net::error::host_not_found_try_again;
+    case 3u: return net::error::host_not_found;
+    default: return net::error::no_recovery;
+  }
+
+  const auto end = msg.data() + msg.size();
+  auto p = msg.data() + 12;
+  for (auto qd = read16(msg.data() + 4); qd > 0u; qd--)
+  {
+    if (!skip_name(p, end) || end - p < 4)
+      return net::error::no_recovery;
+    p += 4;
+  }
+
+  // CNAMEs are followed by the records of the canonical name, so they can just be skipped.
+  for (auto an = read16(msg.data() + 6); an > 0u; an--)
+  {
+    if (!skip_name(p, end) || end - p < 10)
+      return net::error::no_recovery;
+    const auto type  = read16(p);
+    const auto class_ = read16(p + 2);
+    const auto rdlen = read16(p + 8);
+    p += 10;
+    if (end - p < rdlen)
+      return net::error::no_recovery;
+
+    if (class_ == 1u && type == qtype)
+    {
+      if (type == type_a && rdlen == 4u)
+        out.push_back(make_ip_endpoint(AF_INET, p, port));
+      else if (type == type_aaaa && rdlen == 16u)
+        out.push_back(make_ip_endpoint(AF_INET6, p, port));
+    }
+    p += rdlen;
+  }
+
+  return out.empty() ? net::error::no_data : error_code{};
+}
+
+}
+
+struct dns_resolver::query_ final : std::enable_shared_from_this<query_>
+{
+  struct question
+  {
+    std::uint16_t type;
+    std::uint16_t id = 0u;
+    enum {udp, tcp, done} state = udp;
+    std::vector<unsigned char> msg;
+    std::vector<endpoint> result;
+    error_code error;
+    std::optional<tcp_socket> stream;
+    std::array<unsigned char, 2u> length;
+    std::vector<unsigned char> response;
+  };
+
+  query_(dns_resolver * owner, std::uint16_t port, completion_handler<error_code, endpoint_sequence> handler)
+      : owner(owner), exec(owner->executor_), nameservers(owner->config_.nameservers),
+        timeout(owner->config_.timeout), tries(owner->config_.nameservers.size() * owner->config_.attempts),
+        port(port), udp(exec), timer(exec), handler(std::move(handler))
+  {
+  }
+
+  dns_resolver * owner;
+  std::list<std::weak_ptr<query_>>::iterator itr;
+  executor exec;
+  std::vector<endpoint> nameservers;
+  std::chrono::steady_clock::duration timeout;
+  std::size_t tries, attempt = 0u, generation = 0u;
+  std::uint16_t port;
+  endpoint nameserver;
+
+  udp_socket udp;
+  timer_type timer;
+  std::array<question, 2u> questions{question{type_aaaa}, question{type_a}};
+  std::array<unsigned char, 512u> buffer;
+  std::optional<completion_handler<error_code, endpoint_sequence>> handler;
+
+  bool all_done() const
+  {
+    return std::all_of(questions.begin(), questions.end(), [](auto & q) {return q.state == question::done;});
+  }
+
+  void close_all()
+  {
+    error_code ec;
+    udp.close(ec);
+    for (auto & q : questions)
+      if (q.stream)
+        q.stream->close(ec);
+  }
+
+  // send every unanswered question to the next nameserver.
+  void start_attempt()
+  {
+    if (attempt >= tries)
+    {
+      for (auto & q : questions)
+        if (q.state != question::done)
+        {
+          q.state = question::done;
+          q.error = net::error::timed_out;
+        }
+      return complete();
+    }
+
+    const auto gen = ++generation;
+    close_all();
+    nameserver = nameservers[attempt++ % nameservers.size()];
+
+    error_code ec;
+    udp.open(protocol_type(nameserver.protocol().family(), SOCK_DGRAM, IPPROTO_UDP), ec);
+    if (!ec)
+      udp.connect(nameserver, ec);
+
+    std::random_device rd;
+    for (auto & q : questions)
+      if (q.state != question::done && !ec)
+      {
+        q.state = question::udp;
+        q.id = static_cast<std::uint16_t>(rd());
+        q.msg[0] = static_cast<unsigned char>(q.id >> 8);
+        q.msg[1] = static_cast<unsigned char>(q.id & 0xFFu);
+        udp.send(net::buffer(q.msg), 0, ec);
+      }
+
+    if (ec)
+      return start_attempt();
+
+    timer.expires_after(timeout);
+    timer.async_wait(
+        [self = shared_from_this(), gen](error_code ec)
+        {
+          if (!ec && gen == self->generation && self->handler)
+            self->start_attempt();
+        });
+    receive(gen);
+  }
+
+  void receive(std::size_t gen)
+  {
+    udp.async_receive(
+        net::buffer(buffer),
+        [self = shared_from_this(), gen](error_code ec, std::size_t n)
+        {
+          self->received(gen, ec, n);
+        });
+  }
+
+  void received(std::size_t gen, error_code ec, std::size_t n)
+  {
+    if (gen != generation || !handler)
+      return;
+    if (ec) // e.g. connection refused, i.e. no nameserver on that address.
+      return start_attempt();
+
+    if (n >= 12u && (buffer[2] & 0x80u))
+    {
+      const auto id = read16(buffer.data());
+      for (auto & q : questions)
+        if (q.state == question::udp && q.id == id)
+        {
+          bool truncated = false;
+          q.error = parse_response({buffer.data(), n}, q.type, port, q.result, truncated);
+          if (truncated)
+          {
+            q.result.clear();
+            start_tcp(q, gen);
+          }
+          else
+            q.state = question::done;
+        }
+    }
+
+    if (all_done())
+      return complete();
+    if (std::any_of(questions.begin(), questions.end(), [](auto & q) {return q.state == question::udp;}))
+      receive(gen);
+  }
+
+  void start_tcp(question & q, std::size_t gen)
+  {
+    q.state = question::tcp;
+    auto & s = q.stream.emplace(exec);
+    error_code ec;
+    s.open(protocol_type(nameserver.protocol().family(), SOCK_STREAM, IPPROTO_TCP), ec);
+    if (ec)
+      return tcp_done(q, ec);
+
+    s.async_connect(
+        nameserver,
+        [self = shared_from_this(), &q, gen](error_code ec)
+        {
+          if (gen != self->generation || !self->handler)
+            return;
+          if (ec)
+            return self->tcp_done(q, ec);
+          self->tcp_write(q, gen);
+        });
+  }
+
+  void tcp_write(question & q, std::size_t gen)
+  {
+    q.length = {static_cast<unsigned char>(q.msg.size() >> 8), static_cast<unsigned char>(q.msg.size() & 0xFFu)};
+    std::array<net::const_buffer, 2u> buffers{net::buffer(q.length), net::buffer(q.msg)};
+    net::async_write(
+        *q.stream, buffers,
+        [self = shared_from_this(), &q, gen](error_code ec, std::size_t)
+        {
+          if (gen != self->generation || !self->handler)
+            return;
+          if (ec)
+            return self->tcp_done(q, ec);
+          self->tcp_read(q, gen);
+        });
+  }
+
+  void tcp_read(question & q, std::size_t gen)
+  {
+    net::async_read(
+        *q.stream, net::buffer(q.length),
+        [self = shared_from_this(), &q, gen](error_code ec, std::size_t)
+        {
+          if (gen != self->generation || !self->handler)
+            return;
+          if (ec)
+            return self->tcp_done(q, ec);
+
+          q.response.resize(read16(q.length.data()));
+          net::async_read(
+              *q.stream, net::buffer(q.response),
+              [self, &q, gen](error_code ec, std::size_t)
+              {
+                if (gen != self->generation || !self->handler)
+                  return;
+                if (ec)
+                  return self->tcp_done(q, ec);
+                if (q.response.size() < 12u || read16(q.response.data()) != q.id || !(q.response[2] & 0x80u))
+                  return self->tcp_done(q, net::error::no_recovery);
+
+                bool truncated = false;
+                self->tcp_done(q, parse_response(q.response, q.type, self->port, q.result, truncated));
+              });
+        });
+  }
+
+  void tcp_done(question & q, error_code ec)
+  {
+    q.error = ec;
+    q.state = question::done;
+    error_code ig;
+    q.stream->close(ig);
+    if (all_done())
+      complete();
+  }
+
+  void cancel()
+  {
+    generation++;
+    timer.cancel();
+    close_all();
+    net::post(exec, [self = shared_from_this()] { self->complete(net::error::operation_aborted); });
+  }
+
+  void complete(error_code ec = {})
+  {
+    if (!handler)
+      return;
+    generation++;
+    timer.cancel();
+    close_all();
+
+#if !defined(BOOST_COBALT_NO_PMR)
+    endpoint_sequence res{this_thread::get_allocator()};
+#else
+    endpoint_sequence res{};
+#endif
+    if (!ec)
+    {
+      for (auto & q : questions)
+        res.insert(res.end(), q.result.begin(), q.result.end());
+
+      // report the more informative error, if neither question got an address.
+      if (res.empty())
+      {
+        ec = net::error::host_not_found;
+        for (auto & q : questions)
+          if (q.error && q.error != net::error::no_data && q.error != net::error::host_not_found)
+            ec = q.error;
+      }
+    }
+
+    if (owner)
+      owner->queries_.erase(itr);
+    owner = nullptr;
+
+    auto h = std::move(*handler);
+    handler.reset();
+    std::move(h)(ec, std::move(res));
+  }
+};
+
+auto dns_resolver::load_config(const char * resolv_conf) -> config
+{
+  config cfg;
+  std::ifstream file{resolv_conf};
+  std::string line;
+  while (std::getline(file, line))
+  {
+    std::istringstream in{line.substr(0u, line.find_first_of("#;"))};
+    std::string key, value;
+    if (!(in >> key))
+      continue;
+
+    if (key == "nameserver" && (in >> value) && cfg.nameservers.size() < 3u)
+    {
+      int family;
+      std::array<std::uint8_t, 16u> bytes;
+      if (parse_numeric(value, family, bytes))
+        cfg.nameservers.push_back(make_ip_endpoint(family, bytes.data(), 53u));
+    }
+    else if (key == "options")
+      while (in >> value)
+      {
+        unsigned n;
+        const auto colon = value.find(':');
+        if (colon == std::string::npos ||
+            std::from_chars(value.data() + colon + 1u, value.data() + value.size(), n).ec != std::errc{})
+          continue;
+        if (value.starts_with("timeout:"))
+          cfg.timeout = std::chrono::seconds(n);
+        else if (value.starts_with("attempts:"))
+          cfg.attempts = n;
+      }
+  }
+
+  if (cfg.nameservers.empty())
+    cfg.nameservers.push_back(endpoint(ip_v4, static_cast<std::uint32_t>(htonl(INADDR_LOOPBACK)), 53u));
+  return cfg;
+}
+
+dns_resolver::dns_resolver(const cobalt::executor & executor) : dns_resolver(load_config(), executor) {}
+
+dns_resolver::dns_resolver(config cfg, const cobalt::executor & executor)
+    : executor_(executor), config_(std::move(cfg))
+{
+  std::ignore = load_hosts();
+}
+
+dns_resolver::~dns_resolver()
+{
+  for (auto & w : queries_)
+    if (auto q = w.lock())
+    {
+      q->owner = nullptr;
+      q->cancel();
+    }
+}
+
+result<void> dns_resolver::load_hosts(const char * path)
+{
+  std::ifstream file{path};
+  if (!file)
+    return error_code{errno, boost::system::system_category()};
+
+  hosts_.clear();
+  std::string line;
+  while (std::getline(file, line))
+  {
+    std::istringstream in{line.substr(0u, line.find('#'))};
+    std::string addr, name;
+    host_address ha;
+    if (!(in >> addr) || !parse_numeric(addr, ha.family, ha.bytes))
+      continue;
+    while (in >> name)
+      hosts_[lowercase(name)].push_back(ha);
+  }
+  return {};
+}
+
+void dns_resolver::cancel()
+{
+  for (auto & w : queries_)
+    if (auto q = w.lock())
+      q->cancel();
+}
+
+void dns_resolver::try_resolve_(void * this_, std::string_view host, std::string_view service,
+                                boost::cobalt::handler<error_code, endpoint_sequence> h)
+{
+  auto r = static_cast<dns_resolver*>(this_);
+#if !defined(BOOST_COBALT_NO_PMR)
+  endpoint_sequence res{this_thread::get_allocator()};
+#else
+  endpoint_sequence res{};
+#endif
+
+  const auto port = parse_port(service);
+  if (!port)
+    return h(net::error::service_not_found, std::move(res));
+
+  host_address ha;
+  if (parse_numeric(host, ha.family, ha.bytes))
+  {
+    res.push_back(make_ip_endpoint(ha.family, ha.bytes.data(), *port));
+    return h({}, std::move(res));
+  }
+
+  auto itr = r->hosts_.find(lowercase(host));
+  if (itr == r->hosts_.end())
+    return;
+
+  for (auto & a : itr->second)
+    res.push_back(make_ip_endpoint(a.family, a.bytes.data(), *port));
+  h({}, std::move(res));
+}
+
+void dns_resolver::initiate_resolve_(void * this_, std::string_view host, std::string_view service,
+                                     boost::cobalt::completion_handler<error_code, endpoint_sequence> h)
+{
+  auto r = static_cast<dns_resolver*>(this_);
+  const auto port = parse_port(service);
+  if (!port)
+    return h(net::error::service_not_found, {});
+
+  auto q = std::make_shared<query_>(r, *port, std::move(h));
+  for (auto & qs : q->questions)
+    if (!encode_query(host, qs.type, qs.msg))
+    {
+      q->owner = nullptr;
+      return q->complete(net::error::host_not_found);
+    }
+
+  q->itr = r->queries_.insert(r->queries_.end(), q);
+  q->start_attempt();
+}
+
+}
@@ -6,7 +6,14 @@
 //
 
 #include <cobalt/io/endpoint.hpp>
-#include <boost/asio/ip/address.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+
+#include <net/if.h>
 
 #include <boost/url/parse.hpp>
 #include <boost/url/url_view.hpp>
@@ -43,7 +50,7 @@ std::size_t tag_invoke(make_endpoint_tag<AF_UNIX>,
   if (sv.size() >= sizeof(un->sun_path))
     BOOST_THROW_EXCEPTION(std::length_error("unix path too long"));
   *std::copy(sv.begin(), sv.end(), un->sun_path) = '\0';
-  return sizeof(un->sun_family + sv.size() + 1u);
+  return offsetof(net::detail::sockaddr_un_type, sun_path) + sv.size() + 1u;
 }
 
 const local_endpoint* tag_invoke(get_endpoint_tag<AF_UNIX>,
@@ -58,8 +65,8 @@ const local_endpoint* tag_invoke(get_endpoint_tag<AF_UNIX>,
 boost::static_string<15> ip_address_v4::addr_str() const
 {
   char buf[16];
-  inet_ntop(AF_INET, &in_.sin_addr.s_addr, buf, sizeof(buf));
-  return buf;
+  const auto bytes = reinterpret_cast<const std::uint8_t*>(&in_.sin_addr.s_addr);
+  return {buf, detail::format_ipv4(std::span<const std::uint8_t, 4u>(bytes, 4u), buf)};
 }
 
 
@@ -81,18 +88,13 @@ std::size_t tag_invoke(make_endpoint_tag<AF_INET>,
                        std::string_view address,
                        std::uint16_t port)
 {
-  if (address.size() > 15)
-    BOOST_THROW_EXCEPTION(std::length_error("ipv4 address too long"));
-  boost::static_string<16> addr{address.begin(), address.end()};
+  std::uint8_t bytes[4];
+  if (!detail::parse_ipv4(address, bytes))
+    BOOST_THROW_EXCEPTION(boost::system::system_error(net::error::invalid_argument));
 
-
-  auto a = net::ip::make_address_v4(addr.c_str()).to_uint();
-  auto in4 = new (base) net::detail::sockaddr_in4_type{
-      .sin_family=AF_INET,
-      .sin_port=boost::endian::native_to_big(port),
-      .sin_addr={net::detail::socket_ops::host_to_network_long(a)}
-  };
-  return sizeof(net::detail::sockaddr_in4_type);
+  std::uint32_t a;
+  std::memcpy(&a, bytes, sizeof(a));
+  return tag_invoke(make_endpoint_tag<AF_INET>{}, base, a, port);
 }
 
 const ip_address_v4* tag_invoke(get_endpoint_tag<AF_INET>,
@@ -108,8 +110,7 @@ const ip_address_v4* tag_invoke(get_endpoint_tag<AF_INET>,
 boost::static_string<45> ip_address_v6::addr_str() const
 {
   char buf[46];
-  inet_ntop(AF_INET6, &in_.sin6_addr.s6_addr, buf, sizeof(buf));
-  return buf;
+  return {buf, detail::format_ipv6(std::span<const std::uint8_t, 16u>(in_.sin6_addr.s6_addr), buf)};
 }
 
 
@@ -126,23 +127,49 @@ std::size_t tag_invoke(make_endpoint_tag<AF_INET6>,
   return sizeof(net::detail::sockaddr_in6_type);
 }
 
+namespace
+{
+
+// a numeric zone or an interface name.
+std::uint32_t scope_id(std::string_view scope)
+{
+  std::uint32_t id = 0u;
+  auto [ptr, ec] = std::from_chars(scope.data(), scope.data() + scope.size(), id);
+  if (ec == std::errc{} && ptr == scope.data() + scope.size())
+    return id;
+
+  char name[IF_NAMESIZE];
+  if (scope.size() < sizeof(name))
+  {
+    *std::copy(scope.begin(), scope.end(), name) = '\0';
+    id = ::if_nametoindex(name);
+  }
+  if (id == 0u)
+    BOOST_THROW_EXCEPTION(boost::system::system_error(net::error::invalid_argument));
+  return id;
+}
+
+std::size_t make_ipv6(net::detail::socket_addr_type* base, std::span<std::uint8_t, 16u> bytes,
+                      std::uint16_t port, std::string_view scope)
+{
+  const auto n = tag_invoke(make_endpoint_tag<AF_INET6>{}, base, bytes, port);
+  if (!scope.empty())
+    reinterpret_cast<net::detail::sockaddr_in6_type*>(base)->sin6_scope_id = scope_id(scope);
+  return n;
+}
+
+}
+
 std::size_t tag_invoke(make_endpoint_tag<AF_INET6>,
                        net::detail::socket_addr_type* base,
                        std::string_view address,
                        std::uint16_t port)
 {
-  if (address.size() > 45)
-    BOOST_THROW_EXCEPTION(std::length_error("ipv6 address too long"));
-
-  boost::static_string<46> addr{address.begin(), address.end()};
-
-  auto a = net::ip::make_address_v6(addr.c_str()).to_bytes();
-  auto in6 = new (base) net::detail::sockaddr_in6_type{
-      .sin6_family=AF_INET6,
-      .sin6_port=boost::endian::native_to_big(port)
-  };
-  std::copy(a.begin(), a.end(), in6->sin6_addr.s6_addr);
-  return sizeof(net::detail::sockaddr_in6_type);
+  std::uint8_t bytes[16];
+  std::string_view scope;
+  if (!detail::split_ipv6_scope(address, scope) || !detail::parse_ipv6(address, bytes))
+    BOOST_THROW_EXCEPTION(boost::system::system_error(net::error::invalid_argument));
+  return make_ipv6(base, bytes, port, scope);
 }
 
 const ip_address_v6* tag_invoke(get_endpoint_tag<AF_INET6>,
@@ -176,11 +203,11 @@ std::array<std::uint8_t, 16u> ip_address::addr() const
 boost::static_string<45> ip_address::addr_str() const
 {
   char buf[46];
-  inet_ntop(addr_.ss_family,
-            (addr_.ss_family == AF_INET6) ?
-            static_cast<const void*>(&in6_.sin6_addr.s6_addr) : &in_.sin_addr.s_addr,
-            buf, sizeof(buf));
-  return buf;
+  if (addr_.ss_family == AF_INET6)
+    return {buf, detail::format_ipv6(std::span<const std::uint8_t, 16u>(in6_.sin6_addr.s6_addr), buf)};
+
+  const auto bytes = reinterpret_cast<const std::uint8_t*>(&in_.sin_addr.s_addr);
+  return {buf, detail::format_ipv4(std::span<const std::uint8_t, 4u>(bytes, 4u), buf)};
 }
 
 std::size_t tag_invoke(make_endpoint_tag<AF_UNSPEC>,
@@ -188,30 +215,129 @@ std::size_t tag_invoke(make_endpoint_tag<AF_UNSPEC>,
                        std::string_view address,
                        std::uint16_t port)
 {
-  if (address.size() > 45)
-    BOOST_THROW_EXCEPTION(std::length_error("unspecified address too long"));
+  if (address.size() > 2u && address.front() == '[' && address.back() == ']')
+    address = address.substr(1u, address.size() - 2u);
+
+  std::uint8_t bytes[16];
+  if (detail::parse_ipv4(address, std::span<std::uint8_t, 4u>(bytes, 4u)))
+  {
+    std::uint32_t a;
+    std::memcpy(&a, bytes, sizeof(a));
+    return tag_invoke(make_endpoint_tag<AF_INET>{}, base, a, port);
+  }
+  std::string_view scope;
+  if (detail::split_ipv6_scope(address, scope) && detail::parse_ipv6(address, bytes))
+    return make_ipv6(base, bytes, port, scope);
+
+  BOOST_THROW_EXCEPTION(boost::system::system_error(net::error::invalid_argument));
+}
+
+std::size_t tag_invoke(make_endpoint_tag<AF_UNSPEC>,
+                       net::detail::socket_addr_type* base,
+                       std::string_view address_and_port)
+{
+  detail::ip_literal lit;
+  if (!detail::parse_ip_literal(address_and_port, lit))
+    BOOST_THROW_EXCEPTION(boost::system::system_error(net::error::invalid_argument));
 
-  boost::static_string<46> addr{address.begin(), address.end()};
+  if (lit.family == AF_INET)
+  {
+    std::uint32_t a;
+    std::memcpy(&a, lit.bytes, sizeof(a));
+    return tag_invoke(make_endpoint_tag<AF_INET>{}, base, a, lit.port);
+  }
+  return make_ipv6(base, lit.bytes, lit.port, lit.scope);
+}
 
-  auto ad = net::ip::make_address(addr.c_str());
-  if (ad.is_v4())
+endpoint::endpoint(const cobalt::detail::ip_literal & lit) : base_{}
+{
+  std::uint8_t bytes[16];
+  std::copy(std::begin(lit.bytes), std::end(lit.bytes), bytes);
+  if (lit.family == AF_INET)
   {
-    new (base) net::detail::sockaddr_in4_type{
-        .sin_family=AF_INET,
-        .sin_port=boost::endian::native_to_big(port),
-        .sin_addr={net::detail::socket_ops::network_to_host_long(ad.to_v4().to_uint())}
-    };
-    return sizeof(net::detail::sockaddr_in4_type);
+    std::uint32_t a;
+    std::memcpy(&a, bytes, sizeof(a));
+    size_ = tag_invoke(make_endpoint_tag<AF_INET>{}, &base_, a, lit.port);
   }
   else
+    size_ = make_ipv6(&base_, bytes, lit.port, lit.scope);
+}
+
+namespace
+{
+
+// the splitmix64 finalizer
+constexpr std::uint64_t mix(std::uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+std::string_view local_path(const endpoint & ep)
+{
+  const auto un = static_cast<const net::detail::sockaddr_un_type*>(ep.data());
+  const auto offset = offsetof(net::detail::sockaddr_un_type, sun_path);
+  const auto len = ep.size() > offset ? std::min(ep.size() - offset, sizeof(un->sun_path)) : 0u;
+  return {un->sun_path, ::strnlen(un->sun_path, len)};
+}
+
+}
+
+bool operator==(const endpoint & lhs, const endpoint & rhs) noexcept
+{
+  const auto family = lhs.protocol().family();
+  if (family != rhs.protocol().family())
+    return false;
+
+  switch (family)
+  {
+    case AF_INET:
+    {
+      const auto l = static_cast<const net::detail::sockaddr_in4_type*>(lhs.data());
+      const auto r = static_cast<const net::detail::sockaddr_in4_type*>(rhs.data());
+      return l->sin_addr.s_addr == r->sin_addr.s_addr && l->sin_port == r->sin_port;
+    }
+    case AF_INET6:
+    {
+      const auto l = static_cast<const net::detail::sockaddr_in6_type*>(lhs.data());
+      const auto r = static_cast<const net::detail::sockaddr_in6_type*>(rhs.data());
+      return std::memcmp(l->sin6_addr.s6_addr, r->sin6_addr.s6_addr, 16u) == 0
+          && l->sin6_port == r->sin6_port && l->sin6_scope_id == r->sin6_scope_id;
+    }
+    case AF_UNIX:
+      return local_path(lhs) == local_path(rhs);
+    default:
+      return lhs.size() == rhs.size() && std::memcmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+  }
+}
+
+std::size_t hash_value(const endpoint & ep) noexcept
+{
+  switch (ep.protocol().family())
   {
-    auto in6 = new (base) net::detail::sockaddr_in6_type{
-        .sin6_family=AF_INET6,
-        .sin6_port=boost::endian::native_to_big(port)
-    };
-    auto a = ad.to_v6().to_bytes();
-    std::copy(a.begin(), a.end(), in6->sin6_addr.s6_addr);
-    return sizeof(net::detail::sockaddr_in4_type);
+    case AF_INET:
+    {
+      const auto in = static_cast<const net::detail::sockaddr_in4_type*>(ep.data());
+      return static_cast<std::size_t>(
+          mix(std::uint64_t{AF_INET} << 48 | std::uint64_t{in->sin_addr.s_addr} << 16 | in->sin_port));
+    }
+    case AF_INET6:
+    {
+      const auto in6 = static_cast<const net::detail::sockaddr_in6_type*>(ep.data());
+      std::uint64_t hi, lo;
+      std::memcpy(&hi, in6->sin6_addr.s6_addr, sizeof(hi));
+      std::memcpy(&lo, in6->sin6_addr.s6_addr + 8, sizeof(lo));
+      return static_cast<std::size_t>(
+          mix(hi ^ mix(lo ^ (std::uint64_t{in6->sin6_port} << 32 | in6->sin6_scope_id))));
+    }
+    case AF_UNIX:
+      return std::hash<std::string_view>{}(local_path(ep));
+    default:
+      return std::hash<std::string_view>{}({static_cast<const char*>(ep.data()), ep.size()});
   }
 }
 
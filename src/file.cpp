@@ -5,8 +5,11 @@
 // file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 //
 
+#include <cobalt/io/blocking_pool.hpp>
 #include <cobalt/io/file.hpp>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 
 namespace cobalt::io
@@ -186,5 +189,47 @@ result<void> file::close()
 #endif
 
 
+void file::initiate_sync_all_(void * this_, boost::cobalt::completion_handler<error_code> handler)
+{
+  blocking_pool::get(handler.get_executor()).post(
+      [fd = static_cast<file*>(this_)->native_handle()]
+      {
+        return std::make_tuple(::fsync(fd) == -1 ? error_code{errno, ::boost::system::system_category()} : error_code{});
+      },
+      std::move(handler));
+}
+
+void file::initiate_sync_data_(void * this_, boost::cobalt::completion_handler<error_code> handler)
+{
+  blocking_pool::get(handler.get_executor()).post(
+      [fd = static_cast<file*>(this_)->native_handle()]
+      {
+#if defined(_POSIX_SYNCHRONIZED_IO)
+        const int r = ::fdatasync(fd);
+#else
+        const int r = ::fsync(fd);
+#endif
+        return std::make_tuple(r == -1 ? error_code{errno, ::boost::system::system_category()} : error_code{});
+      },
+      std::move(handler));
 }
 
+result<void> file::sync_range(std::uint64_t offset, std::uint64_t len, sync_range_flags flags)
+{
+#if defined(SYNC_FILE_RANGE_WRITE)
+  static_assert(sync_wait_before == SYNC_FILE_RANGE_WAIT_BEFORE);
+  static_assert(sync_write       == SYNC_FILE_RANGE_WRITE);
+  static_assert(sync_wait_after  == SYNC_FILE_RANGE_WAIT_AFTER);
+
+  if (::sync_file_range(native_handle(), static_cast<off_t>(offset), static_cast<off_t>(len), flags) == -1)
+  {
+    constexpr static boost::source_location loc{BOOST_CURRENT_LOCATION};
+    return error_code{errno, ::boost::system::system_category(), &loc};
+  }
+  return {};
+#else
+  return error_code{net::error::operation_not_supported};
+#endif
+}
+
+}
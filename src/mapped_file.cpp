@@ -0,0 +1,193 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <cobalt/io/mapped_file.hpp>
+#include <cobalt/io/blocking_pool.hpp>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace cobalt::io
+{
+
+#if !defined(COBALT_RETURN_ERROR)
+#define COBALT_RETURN_ERROR()                                            \
+  do {                                                                   \
+    constexpr static boost::source_location loc{BOOST_CURRENT_LOCATION}; \
+    return error_code{errno, ::boost::system::system_category(), &loc};  \
+  }                                                                      \
+  while(true)
+#endif
+
+namespace
+{
+
+std::size_t page_size()
+{
+  static const auto sz = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  return sz;
+}
+
+}
+
+mapped_file::mapped_file(const cobalt::executor & executor) : executor_(executor) {}
+
+mapped_file::mapped_file(file & f, std::uint64_t offset, std::size_t length, bool writable,
+                         const cobalt::executor & executor)
+    : executor_(executor)
+{
+  map(f, offset, length, writable).value();
+}
+
+mapped_file::mapped_file(mapped_file && lhs) noexcept
+    : executor_(lhs.executor_),
+      data_(std::exchange(lhs.data_, nullptr)),
+      size_(std::exchange(lhs.size_, 0u)),
+      page_offset_(std::exchange(lhs.page_offset_, 0u))
+{
+}
+
+mapped_file& mapped_file::operator=(mapped_file && lhs) noexcept
+{
+  if (this != &lhs)
+  {
+    unmap();
+    executor_ = lhs.executor_;
+    data_ = std::exchange(lhs.data_, nullptr);
+    size_ = std::exchange(lhs.size_, 0u);
+    page_offset_ = std::exchange(lhs.page_offset_, 0u);
+  }
+  return *this;
+}
+
+mapped_file::~mapped_file()
+{
+  unmap();
+}
+
+result<void> mapped_file::map(file & f, std::uint64_t offset, std::size_t length, bool writable)
+{
+  if (auto r = unmap(); !r)
+    return r;
+
+  // pages past the end of the file can't be backed, touching them raises SIGBUS.
+  auto sz = f.size();
+  if (!sz)
+    return sz.error();
+  if (*sz < offset)
+    return error_code{net::error::invalid_argument};
+  length = static_cast<std::size_t>((std::min<std::uint64_t>)(length, *sz - offset));
+
+  // an empty mapping is just unmapped.
+  if (length == 0u)
+    return {};
+
+  const auto delta = static_cast<std::size_t>(offset % page_size());
+  void * p = ::mmap(nullptr, length + delta, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED,
+                    f.native_handle(), static_cast<off_t>(offset - delta));
+  if (p == MAP_FAILED)
+    COBALT_RETURN_ERROR();
+
+  data_ = static_cast<std::byte*>(p) + delta;
+  size_ = length;
+  page_offset_ = delta;
+  return {};
+}
+
+result<void> mapped_file::unmap()
+{
+  if (!data_)
+    return {};
+
+  const auto res = ::munmap(data_ - page_offset_, size_ + page_offset_);
+  data_ = nullptr;
+  size_ = page_offset_ = 0u;
+  if (res != 0)
+    COBALT_RETURN_ERROR();
+  return {};
+}
+
+result<void> mapped_file::advise(advice adv, std::size_t offset, std::size_t length)
+{
+  int flag;
+  switch (adv)
+  {
+    case normal:     flag = MADV_NORMAL;     break;
+    case sequential: flag = MADV_SEQUENTIAL; break;
+    case random:     flag = MADV_RANDOM;     break;
+    case will_need:  flag = MADV_WILLNEED;   break;
+    case dont_need:  flag = MADV_DONTNEED;   break;
+#if defined(MADV_HUGEPAGE)
+    case huge_page:  flag = MADV_HUGEPAGE;   break;
+#endif
+    default:
+      return error_code{net::error::operation_not_supported};
+  }
+
+  offset = clamp_(offset, length);
+  if (length == 0u)
+    return {};
+
+  // madvise needs a page aligned address.
+  const auto misalign = (page_offset_ + offset) % page_size();
+  if (::madvise(data_ + offset - misalign, length + misalign, flag) != 0)
+    COBALT_RETURN_ERROR();
+  return {};
+}
+
+result<void> mapped_file::flush(bool wait)
+{
+  if (!data_)
+    return {};
+  if (::msync(data_ - page_offset_, size_ + page_offset_, wait ? MS_SYNC : MS_ASYNC) != 0)
+    COBALT_RETURN_ERROR();
+  return {};
+}
+
+void mapped_file::initiate_prefetch_(void * this_, std::size_t offset, std::size_t length,
+                                     boost::cobalt::completion_handler<error_code> handler)
+{
+  auto t = static_cast<mapped_file*>(this_);
+  offset = t->clamp_(offset, length);
+  if (length == 0u)
+    return handler(error_code{});
+
+  const auto misalign = (t->page_offset_ + offset) % page_size();
+  const auto begin = t->data_ + offset - misalign;
+  const auto end   = t->data_ + offset + length;
+
+  // WILLNEED only starts the readahead, so wait for it with mincore. Touching the pages instead
+  // would raise SIGBUS if the file got truncated underneath the mapping.
+  blocking_pool::get(t->executor_).post(
+      [begin, end]() -> std::tuple<error_code>
+      {
+        const auto len = static_cast<std::size_t>(end - begin);
+        if (::madvise(begin, len, MADV_WILLNEED) != 0)
+          COBALT_RETURN_ERROR();
+
+        std::vector<unsigned char> resident((len + page_size() - 1u) / page_size());
+        // give up eventually, e.g. if the pages get evicted again under memory pressure.
+        for (auto delay = std::chrono::microseconds(50); delay < std::chrono::milliseconds(100); delay *= 2)
+        {
+          if (::mincore(begin, len, resident.data()) != 0)
+            COBALT_RETURN_ERROR();
+          if (std::all_of(resident.begin(), resident.end(), [](unsigned char c) {return (c & 1u) != 0u;}))
+            return {};
+          std::this_thread::sleep_for(delay);
+        }
+        return {net::error::timed_out};
+      },
+      std::move(handler));
+}
+
+}
@@ -0,0 +1,103 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <cobalt/io/periodic_timer.hpp>
+
+#include <boost/asio/append.hpp>
+#include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+
+namespace cobalt::io
+{
+
+periodic_timer::periodic_timer(const duration & period, const cobalt::executor & executor)
+    : periodic_timer(clock_type::now() + period, period, executor)
+{
+}
+
+periodic_timer::periodic_timer(const time_point & first, const duration & period, const cobalt::executor & executor)
+    : wheel_(timer_wheel::get(executor)), next_(first), period_(period)
+{
+  BOOST_ASSERT(period > duration::zero());
+}
+
+periodic_timer::~periodic_timer()
+{
+  cancel();
+}
+
+void periodic_timer::cancel()
+{
+  if (wheel_.cancel(entry_))
+    complete_(net::error::operation_aborted, 0u, true);
+}
+
+void periodic_timer::reset(const time_point & first, const duration & period)
+{
+  BOOST_ASSERT(period > duration::zero());
+  cancel();
+  next_ = first;
+  period_ = period;
+}
+
+// consume the due tick & skip the ones that have passed as well.
+std::size_t periodic_timer::advance_(time_point now)
+{
+  const auto missed = static_cast<std::size_t>((now - next_) / period_);
+  next_ += period_ * static_cast<duration::rep>(missed + 1u);
+  return missed;
+}
+
+void periodic_timer::complete_(error_code ec, std::size_t missed, bool clear_slot)
+{
+  auto h = std::move(*handler_);
+  handler_.reset();
+  if (clear_slot)
+    net::get_associated_cancellation_slot(h).clear();
+
+  if (ec)
+    net::post(net::append(std::move(h), ec, missed));
+  else
+    std::move(h)(ec, missed);
+}
+
+void periodic_timer::expired_(void * this_)
+{
+  auto t = static_cast<periodic_timer*>(this_);
+  t->complete_({}, t->advance_(std::max(clock_type::now(), t->next_)), true);
+}
+
+void periodic_timer::initiate_tick_(void * this_, boost::cobalt::completion_handler<error_code, std::size_t> handler)
+{
+  auto t = static_cast<periodic_timer*>(this_);
+  t->cancel();
+  t->handler_.emplace(std::move(handler));
+
+  auto slot = net::get_associated_cancellation_slot(*t->handler_);
+  if (slot.is_connected())
+    slot.assign(
+        [t](net::cancellation_type ct)
+        {
+          // we're inside the slot's handler, so it must not be cleared here.
+          if (ct != net::cancellation_type::none && t->wheel_.cancel(t->entry_))
+            t->complete_(net::error::operation_aborted, 0u, false);
+        });
+
+  t->wheel_.schedule(t->entry_, t->next_, &expired_, t);
+}
+
+void periodic_timer::try_tick_(void * this_, boost::cobalt::handler<error_code, std::size_t> h)
+{
+  auto t = static_cast<periodic_timer*>(this_);
+  const auto now = clock_type::now();
+  if (t->next_ <= now)
+    h({}, t->advance_(now));
+}
+
+}
@@ -5,9 +5,27 @@
 // file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 //
 
+#include <cobalt/io/blocking_pool.hpp>
 #include <cobalt/io/initiate_templates.hpp>
 #include <cobalt/io/random_access_file.hpp>
 
+#include <boost/asio/append.hpp>
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/cobalt/experimental/composition.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 
 namespace cobalt::io
 {
@@ -40,11 +58,17 @@ random_access_file::random_access_file(random_access_file && sf) noexcept = defa
 
 void random_access_file::initiate_read_some_at_(void *this_, std::uint64_t offset,  mutable_buffer_sequence buffer, boost::cobalt::completion_handler<error_code, std::size_t> handler)
 {
-  return initiate_async_read_some_at(static_cast<random_access_file*>(this_)->implementation_, offset, buffer, std::move(handler));
+  auto t = static_cast<random_access_file*>(this_);
+  if (t->direct_ && !t->aligned_(offset, buffer))
+    return initiate_bounce_read_(this_, offset, buffer, std::move(handler));
+  return initiate_async_read_some_at(t->implementation_, offset, buffer, std::move(handler));
 }
 void random_access_file::initiate_write_some_at_(void *this_, std::uint64_t offset, const_buffer_sequence buffer, boost::cobalt::completion_handler<error_code, std::size_t> handler)
 {
-  return initiate_async_write_some_at(static_cast<random_access_file*>(this_)->implementation_, offset, buffer, std::move(handler));
+  auto t = static_cast<random_access_file*>(this_);
+  if (t->direct_ && !t->aligned_(offset, buffer))
+    return initiate_bounce_write_(this_, offset, buffer, std::move(handler));
+  return initiate_async_write_some_at(t->implementation_, offset, buffer, std::move(handler));
 }
 
 #else
@@ -77,52 +101,273 @@ random_access_file::random_access_file(const native_handle_type & native_file,
 
 random_access_file::random_access_file(random_access_file && sf) noexcept = default;
 
-void initiate_async_read_some_at_helper(boost::asio::posix::basic_stream_descriptor<executor> & str,
-                                        std::uint64_t offset, mutable_buffer_sequence seq,
-                                        completion_handler<error_code, std::size_t> handler)
+void random_access_file::initiate_read_some_at_(void *this_, std::uint64_t offset,  mutable_buffer_sequence buffer, boost::cobalt::completion_handler<error_code, std::size_t> handler)
+{
+  auto t = static_cast<random_access_file*>(this_);
+  if (t->direct_ && !t->aligned_(offset, buffer))
+    return initiate_bounce_read_(this_, offset, buffer, std::move(handler));
+  return blocking_read_some_at(t->native_handle(), offset, buffer, std::move(handler));
+}
+void random_access_file::initiate_write_some_at_(void *this_, std::uint64_t offset, const_buffer_sequence buffer, boost::cobalt::completion_handler<error_code, std::size_t> handler)
+{
+  auto t = static_cast<random_access_file*>(this_);
+  if (t->direct_ && !t->aligned_(offset, buffer))
+    return initiate_bounce_write_(this_, offset, buffer, std::move(handler));
+  return blocking_write_some_at(t->native_handle(), offset, buffer, std::move(handler));
+}
+
+#endif
+
+
+result<void> random_access_file::set_direct_io(bool enable)
 {
-  if (lseek64(str.native_handle(), SEEK_SET, offset) < 0)
+#if defined(O_DIRECT)
+  const int fd = native_handle();
+  const int fl = ::fcntl(fd, F_GETFL);
+  if (fl == -1 || ::fcntl(fd, F_SETFL, enable ? (fl | O_DIRECT) : (fl & ~O_DIRECT)) == -1)
   {
     constexpr static boost::source_location loc{BOOST_CURRENT_LOCATION};
-    return handler(error_code{errno, ::boost::system::system_category(), &loc}, 0u);
+    return error_code{errno, ::boost::system::system_category(), &loc};
   }
 
-  if (seq.buffer_count() > 0u)
-    str.async_read_some(seq, std::move(handler));
-  else if (seq.is_registered())
-    str.async_read_some(seq.registered, std::move(handler));
-  else
-    str.async_read_some(seq.head, std::move(handler));
+  direct_ = enable;
+  memory_alignment_ = offset_alignment_ = 1u;
+  if (!enable)
+    return {};
+
+#if defined(STATX_DIOALIGN)
+  struct statx stx;
+  if (::statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 && (stx.stx_mask & STATX_DIOALIGN) && stx.stx_dio_mem_align != 0u)
+  {
+    memory_alignment_ = stx.stx_dio_mem_align;
+    offset_alignment_ = stx.stx_dio_offset_align;
+    return {};
+  }
+#endif
+  // older kernels don't report it, the block size is always enough.
+  struct stat st;
+  memory_alignment_ = offset_alignment_ = (::fstat(fd, &st) == 0 && st.st_blksize > 0) ? static_cast<std::size_t>(st.st_blksize) : 4096u;
+  return {};
+#else
+  return enable ? result<void>{error_code{net::error::operation_not_supported}} : result<void>{};
+#endif
 }
 
-void initiate_async_write_some_at_helper(boost::asio::posix::basic_stream_descriptor<executor> & str,
-                                        std::uint64_t offset, const_buffer_sequence seq,
-                                        completion_handler<error_code, std::size_t> handler)
+// reads the surrounding aligned range & copies the requested part out.
+void random_access_file::initiate_bounce_read_(void * this_, std::uint64_t offset, mutable_buffer_sequence buffer,
+                                               boost::cobalt::completion_handler<error_code, std::size_t>)
 {
-  if (lseek64(str.native_handle(), SEEK_SET, offset) < 0)
+  auto t = static_cast<random_access_file*>(this_);
+  std::size_t total = 0u;
+  for (auto itr = buffer.begin(); itr != buffer.end(); itr++)
+    total += itr->size();
+
+  const auto align = t->offset_alignment_;
+  const auto begin = offset - offset % align;
+  const auto end   = (offset + total + align - 1u) / align * align;
+  std::vector<std::byte, aligned_allocator<std::byte>> bounce(static_cast<std::size_t>(end - begin), t->get_aligned_allocator());
+
+  auto [ec, n] = co_await read_at_op{begin, net::buffer(bounce.data(), bounce.size()), t, &initiate_read_some_at_};
+
+  const auto skip = static_cast<std::size_t>(offset - begin);
+  n = n > skip ? (std::min)(n - skip, total) : 0u;
+
+  auto src = bounce.data() + skip;
+  auto remaining = n;
+  for (auto itr = buffer.begin(); itr != buffer.end() && remaining > 0u; itr++)
   {
-    constexpr static boost::source_location loc{BOOST_CURRENT_LOCATION};
-    return handler(error_code{errno, ::boost::system::system_category(), &loc}, 0u);
+    const auto m = (std::min)(itr->size(), remaining);
+    std::memcpy(itr->data(), src, m);
+    src += m;
+    remaining -= m;
+  }
+  co_return {ec, n};
+}
+
+// offset & sizes are aligned, so only the memory needs copying.
+void random_access_file::initiate_bounce_write_(void * this_, std::uint64_t offset, const_buffer_sequence buffer,
+                                                boost::cobalt::completion_handler<error_code, std::size_t>)
+{
+  auto t = static_cast<random_access_file*>(this_);
+  const auto align = t->offset_alignment_;
+  bool sizes_aligned = offset % align == 0u;
+  for (auto itr = buffer.begin(); itr != buffer.end(); itr++)
+    sizes_aligned = sizes_aligned && itr->size() % align == 0u;
+  if (!sizes_aligned)
+    co_return {net::error::invalid_argument, 0u};
+
+  std::vector<std::byte, aligned_allocator<std::byte>> bounce(t->get_aligned_allocator());
+  for (auto itr = buffer.begin(); itr != buffer.end(); itr++)
+  {
+    auto p = static_cast<const std::byte*>(itr->data());
+    bounce.insert(bounce.end(), p, p + itr->size());
   }
 
-  if (seq.buffer_count() > 0u)
-    str.async_write_some(seq, std::move(handler));
-  else if (seq.is_registered())
-    str.async_write_some(seq.registered, std::move(handler));
-  else
-    str.async_write_some(seq.head, std::move(handler));
+  auto [ec, n] = co_await write_at_op{offset, net::buffer(bounce.data(), bounce.size()), t, &initiate_write_some_at_};
+  co_return {ec, n};
 }
 
-void random_access_file::initiate_read_some_at_(void *this_, std::uint64_t offset,  mutable_buffer_sequence buffer, boost::cobalt::completion_handler<error_code, std::size_t> handler)
+struct random_access_file::read_stream::stream_state_ : std::enable_shared_from_this<stream_state_>
 {
-  return initiate_async_read_some_at_helper(static_cast<random_access_file*>(this_)->file_, offset, buffer, std::move(handler));
+  stream_state_(random_access_file & file, std::span<range> ranges) : file(file), ranges(ranges) {}
+
+  random_access_file & file;
+  std::span<range> ranges;
+  std::unique_ptr<net::cancellation_signal[]> signals{new net::cancellation_signal[ranges.size()]};
+  // completions that haven't been picked up by next yet, as (error, index, size).
+  std::vector<std::tuple<error_code, std::size_t, std::size_t>> completed;
+  std::size_t head = 0u;
+  std::size_t unreported = ranges.size();
+  std::optional<boost::cobalt::completion_handler<error_code, std::size_t, std::size_t>> waiter;
+
+  void complete(std::size_t idx, error_code ec, std::size_t n)
+  {
+    ranges[idx].second = net::mutable_buffer(ranges[idx].second.data(), n);
+    if (!waiter)
+    {
+      completed.emplace_back(ec, idx, n);
+      return;
+    }
+
+    unreported--;
+    take_waiter()(ec, idx, n);
+  }
+
+  // every reset of the waiter goes through here, so the slot never outlives it.
+  boost::cobalt::completion_handler<error_code, std::size_t, std::size_t> take_waiter()
+  {
+    auto h = std::move(*waiter);
+    waiter.reset();
+    net::get_associated_cancellation_slot(h).clear();
+    return h;
+  }
+
+  void cancel()
+  {
+    for (std::size_t i = 0u; i < ranges.size(); i++)
+      signals[i].emit(net::cancellation_type::terminal);
+  }
+
+  template<typename Handler>
+  void read(std::uint64_t offset, net::mutable_buffer buffer, Handler handler)
+  {
+#if defined(BOOST_ASIO_HAS_FILE)
+    file.implementation_.async_read_some_at(offset, buffer, std::move(handler));
+#else
+    blocking_read_some_at(file.get_executor(), file.native_handle(), offset, buffer, std::move(handler));
+#endif
+  }
+
+  void start(std::size_t idx)
+  {
+    auto [offset, buffer] = ranges[idx];
+    if (!file.direct_ || file.aligned_(offset, mutable_buffer_sequence{buffer}))
+      return read(offset, buffer,
+                  net::bind_cancellation_slot(
+                      signals[idx].slot(),
+                      [st = shared_from_this(), idx](error_code ec, std::size_t n) {st->complete(idx, ec, n);}));
+
+    // same as initiate_bounce_read_: read the surrounding aligned range & copy the requested part out.
+    const auto align = file.offset_alignment_;
+    const auto begin = offset - offset % align;
+    const auto end   = (offset + buffer.size() + align - 1u) / align * align;
+    std::vector<std::byte, aligned_allocator<std::byte>> bounce(static_cast<std::size_t>(end - begin), file.get_aligned_allocator());
+    const auto aligned = net::buffer(bounce.data(), bounce.size());
+    read(begin, aligned,
+         net::bind_cancellation_slot(
+             signals[idx].slot(),
+             [st = shared_from_this(), idx, buffer, skip = static_cast<std::size_t>(offset - begin),
+              bounce = std::move(bounce)](error_code ec, std::size_t n)
+             {
+               n = n > skip ? (std::min)(n - skip, buffer.size()) : 0u;
+               std::memcpy(buffer.data(), bounce.data() + skip, n);
+               st->complete(idx, ec, n);
+             }));
+  }
+};
+
+random_access_file::read_stream::read_stream(random_access_file & file, std::span<range> ranges)
+    : state_(std::make_shared<stream_state_>(file, ranges))
+{
+  state_->completed.reserve(ranges.size());
+  for (std::size_t i = 0u; i < ranges.size(); i++)
+    state_->start(i);
 }
-void random_access_file::initiate_write_some_at_(void *this_, std::uint64_t offset, const_buffer_sequence buffer, boost::cobalt::completion_handler<error_code, std::size_t> handler)
+
+random_access_file::read_stream::~read_stream()
 {
-  return initiate_async_write_some_at_helper(static_cast<random_access_file*>(this_)->file_, offset, buffer, std::move(handler));
+  // cancelling io_uring reads is asynchronous, so the kernel may still write into the buffers after this.
+  BOOST_ASSERT_MSG(state_->unreported == 0u, "read_stream destroyed before being drained");
+  if (state_->unreported > 0u)
+    state_->cancel();
+  if (state_->waiter)
+    net::post(net::append(state_->take_waiter(), error_code{net::error::operation_aborted}, std::size_t(0u), std::size_t(0u)));
 }
 
-#endif
+std::size_t random_access_file::read_stream::pending() const
+{
+  return state_->unreported;
+}
 
+void random_access_file::read_stream::cancel()
+{
+  state_->cancel();
+}
+
+void random_access_file::read_stream::try_next_(void * this_, boost::cobalt::handler<error_code, std::size_t, std::size_t> h)
+{
+  auto & st = *static_cast<read_stream*>(this_)->state_;
+  if (st.head < st.completed.size())
+  {
+    st.unreported--;
+    auto [ec, idx, n] = st.completed[st.head++];
+    h(ec, idx, n);
+  }
+  else if (st.unreported == 0u)
+    h(net::error::not_found, 0u, 0u);
 }
 
+void random_access_file::read_stream::initiate_next_(void * this_, boost::cobalt::completion_handler<error_code, std::size_t, std::size_t> h)
+{
+  auto & st = *static_cast<read_stream*>(this_)->state_;
+  if (st.head < st.completed.size())
+  {
+    st.unreported--;
+    auto [ec, idx, n] = st.completed[st.head++];
+    return net::post(net::append(std::move(h), ec, idx, n));
+  }
+  else if (st.unreported == 0u)
+    return net::post(net::append(std::move(h), error_code{net::error::not_found}, std::size_t(0u), std::size_t(0u)));
+
+  BOOST_ASSERT(!st.waiter);
+  st.waiter.emplace(std::move(h));
+  // the reads complete with operation_aborted, one of which then completes the waiter.
+  auto slot = net::get_associated_cancellation_slot(*st.waiter);
+  if (slot.is_connected())
+    slot.assign([st = st.shared_from_this()](net::cancellation_type ct)
+                {
+                  if (ct != net::cancellation_type::none)
+                    st->cancel();
+                });
+}
+
+void random_access_file::initiate_read_many_(void * this_, std::span<range> ranges,
+                                             boost::cobalt::completion_handler<error_code, std::size_t>)
+{
+  read_stream rs{*static_cast<random_access_file*>(this_), ranges};
+  error_code first;
+  std::size_t total = 0u;
+  while (rs.pending() > 0u)
+  {
+    [[maybe_unused]] auto [ec, idx, n] = co_await rs.next();
+    total += n;
+    if (ec && !first)
+    {
+      first = ec;
+      rs.cancel();
+    }
+  }
+  co_return {first, total};
+}
+
+}
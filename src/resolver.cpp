@@ -7,7 +7,11 @@
 
 #include <cobalt/io/resolver.hpp>
 
+#include <boost/asio/append.hpp>
+#include <boost/asio/associated_cancellation_slot.hpp>
 #include <boost/asio/deferred.hpp>
+#include <boost/asio/post.hpp>
+#include <utility>
 
 namespace cobalt::io
 {
@@ -26,7 +30,7 @@ void resolver::resolve_op_::initiate(completion_handler<error_code, endpoint_seq
 #if !defined(BOOST_COBALT_NO_PMR)
             endpoint_sequence r{this_thread::get_allocator()};
 #else
-            endpoints r{};
+            endpoint_sequence r{};
 #endif
             r.assign(rr.begin(), rr.end());
 
@@ -35,4 +39,154 @@ void resolver::resolve_op_::initiate(completion_handler<error_code, endpoint_seq
           }))(std::move(h));
 }
 
-}
\ No newline at end of file
+
+namespace
+{
+
+endpoint_sequence copy_endpoints(const endpoint_sequence & eps)
+{
+#if !defined(BOOST_COBALT_NO_PMR)
+  endpoint_sequence r{this_thread::get_allocator()};
+#else
+  endpoint_sequence r{};
+#endif
+  r.assign(eps.begin(), eps.end());
+  return r;
+}
+
+}
+
+caching_resolver::caching_resolver(std::chrono::steady_clock::duration ttl,
+                                   std::chrono::steady_clock::duration negative_ttl,
+                                   std::chrono::steady_clock::duration stale,
+                                   const cobalt::executor & executor)
+    : ttl_(ttl), negative_ttl_(negative_ttl), stale_(stale), resolver_(executor)
+{
+}
+
+caching_resolver::~caching_resolver()
+{
+  *alive_ = false;
+  resolver_.cancel();
+  for (auto & [_, e] : cache_)
+    for (auto & h : e.waiting)
+      net::get_associated_cancellation_slot(h).clear();
+  for (auto & [_, e] : cache_)
+    for (auto & h : e.waiting)
+      net::post(net::append(std::move(h), error_code{net::error::operation_aborted}, endpoint_sequence{}));
+}
+
+void caching_resolver::cancel() { resolver_.cancel(); }
+
+void caching_resolver::clear()
+{
+  expiry_.clear();
+  std::erase_if(cache_, [](auto & kv) {return !kv.second.querying;});
+}
+
+// drop everything that can't be served anymore, to keep the cache from growing indefinitely.
+void caching_resolver::prune_()
+{
+  const auto now = std::chrono::steady_clock::now();
+  while (!expiry_.empty() && expiry_.begin()->first <= now)
+  {
+    cache_.erase(cache_.find(*expiry_.begin()->second));
+    expiry_.erase(expiry_.begin());
+  }
+}
+
+void caching_resolver::query_(cache_type::iterator itr)
+{
+  auto & entry = itr->second;
+  entry.querying = true;
+  if (entry.drop)
+    expiry_.erase(*std::exchange(entry.drop, std::nullopt));
+  auto & [host, service] = itr->first;
+  resolver_.async_resolve(
+      cobalt::io::ip, host, service,
+      [this, itr, alive = alive_](error_code ec, auto rr)
+      {
+        if (!*alive)
+          return;
+        auto & e = itr->second;
+        e.querying = false;
+        const auto now = std::chrono::steady_clock::now();
+
+        // a failed refresh keeps serving the stale result.
+        if (!ec)
+        {
+          e.endpoints.assign(rr.begin(), rr.end());
+          e.error = {};
+          e.expires = now + ttl_;
+          e.resolved = true;
+        }
+        else if (ec != net::error::operation_aborted && !(e.resolved && !e.error && now < e.expires + stale_))
+        {
+          e.endpoints.clear();
+          e.error = ec;
+          e.expires = now + negative_ttl_;
+          e.resolved = true;
+        }
+
+        e.drop = expiry_.emplace(e.expires + (e.error ? std::chrono::steady_clock::duration{} : stale_), &itr->first);
+
+        // all slots get cleared first, since a handler might cancel one of the others.
+        auto waiting = std::move(e.waiting);
+        e.waiting.clear();
+        for (auto & h : waiting)
+          net::get_associated_cancellation_slot(h).clear();
+        for (auto & h : waiting)
+          std::move(h)(ec ? ec : e.error, copy_endpoints(e.endpoints));
+      });
+}
+
+void caching_resolver::try_resolve_(void * this_, std::string_view host, std::string_view service,
+                                    boost::cobalt::handler<error_code, endpoint_sequence> h)
+{
+  auto r = static_cast<caching_resolver*>(this_);
+  auto itr = r->cache_.find(std::tuple(host, service));
+  if (itr == r->cache_.end() || !itr->second.resolved)
+    return;
+
+  auto & e = itr->second;
+  const auto now = std::chrono::steady_clock::now();
+  if (now < e.expires)
+    return h(e.error, copy_endpoints(e.endpoints));
+
+  if (!e.error && now < e.expires + r->stale_)
+  {
+    if (!e.querying)
+      r->query_(itr);
+    h({}, copy_endpoints(e.endpoints));
+  }
+}
+
+void caching_resolver::initiate_resolve_(void * this_, std::string_view host, std::string_view service,
+                                         boost::cobalt::completion_handler<error_code, endpoint_sequence> h)
+{
+  auto r = static_cast<caching_resolver*>(this_);
+  auto itr = r->cache_.find(std::tuple(host, service));
+  if (itr == r->cache_.end())
+  {
+    r->prune_();
+    itr = r->cache_.emplace(std::tuple(std::string(host), std::string(service)), entry_{}).first;
+  }
+
+  auto & waiting = itr->second.waiting;
+  auto pos = waiting.insert(waiting.end(), std::move(h));
+  // the entry can't get dropped while it's querying, so itr stays valid until the slot gets cleared.
+  auto slot = net::get_associated_cancellation_slot(*pos);
+  if (slot.is_connected())
+    slot.assign(
+        [itr, pos](net::cancellation_type)
+        {
+          auto h = std::move(*pos);
+          itr->second.waiting.erase(pos);
+          net::post(net::append(std::move(h), error_code{net::error::operation_aborted}, endpoint_sequence{}));
+        });
+
+  if (!itr->second.querying)
+    r->query_(itr);
+}
+
+}
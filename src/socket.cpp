@@ -10,6 +10,14 @@
 #include <boost/asio/local/stream_protocol.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/connect.hpp>
+#include <boost/asio/basic_stream_socket.hpp>
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/associated_cancellation_slot.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <vector>
 
 namespace cobalt::io
 {
@@ -205,6 +213,160 @@ void socket::initiate_ranged_connect_(void * this_, endpoint_sequence eps, compl
       sock->socket_, eps, std::move(handler));
 }
 
+namespace
+{
+
+// RFC 8305 section 4: interleave the families, starting with the one of the first endpoint.
+endpoint_sequence interleave_families(endpoint_sequence eps)
+{
+  if (eps.empty())
+    return eps;
+
+  const auto first = eps.front().protocol().family();
+  auto mid = std::stable_partition(eps.begin(), eps.end(),
+                                   [&](const endpoint & ep) {return ep.protocol().family() == first;});
+
+  // move one of the other family behind every endpoint of the first one, in place.
+  for (auto p = eps.begin() + 1; mid != eps.end() && p < mid; p += 2, mid++)
+    std::rotate(p, mid, mid + 1);
+  return eps;
+}
+
+struct happy_eyeballs_state final : std::enable_shared_from_this<happy_eyeballs_state>
+{
+  using attempt_type = net::basic_stream_socket<protocol_type, executor>;
+  using timer_type   = net::basic_waitable_timer<std::chrono::steady_clock,
+                                                 net::wait_traits<std::chrono::steady_clock>,
+                                                 executor>;
+
+  happy_eyeballs_state(net::basic_socket<protocol_type, executor> & target,
+                       endpoint_sequence eps,
+                       std::chrono::steady_clock::duration delay,
+                       completion_handler<error_code, endpoint> handler)
+      : target(target), endpoints(std::move(eps)), delay(delay),
+        timer(target.get_executor()), handler(std::move(handler))
+  {
+    attempts.reserve(endpoints.size());
+  }
+
+  net::basic_socket<protocol_type, executor> & target;
+  endpoint_sequence endpoints;
+  std::chrono::steady_clock::duration delay;
+  timer_type timer;
+  std::vector<attempt_type> attempts;
+  std::size_t running = 0u;
+  bool cancelled = false;
+  error_code last_error = net::error::host_not_found;
+  std::optional<completion_handler<error_code, endpoint>> handler;
+
+  void start()
+  {
+    auto slot = net::get_associated_cancellation_slot(*handler);
+    if (slot.is_connected())
+      slot.assign(
+          [w = weak_from_this()](net::cancellation_type)
+          {
+            if (auto self = w.lock())
+              self->cancel();
+          });
+    start_next();
+  }
+
+  // start attempts until one is in flight, or none are left
+  void start_next()
+  {
+    while (!cancelled && attempts.size() < endpoints.size())
+    {
+      const auto idx = attempts.size();
+      auto & ep = endpoints[idx];
+      auto & sock = attempts.emplace_back(target.get_executor());
+
+      error_code ec;
+      sock.open(ep.protocol(), ec);
+      if (ec)
+      {
+        last_error = ec;
+        continue;
+      }
+
+      running++;
+      sock.async_connect(ep, [self = shared_from_this(), idx](error_code ec) { self->connected(idx, ec); });
+
+      if (attempts.size() < endpoints.size())
+      {
+        timer.expires_after(delay);
+        timer.async_wait(
+            [self = shared_from_this()](error_code ec)
+            {
+              if (!ec)
+                self->start_next();
+            });
+      }
+      return;
+    }
+
+    if (running == 0u)
+      complete(cancelled ? net::error::operation_aborted : last_error, {});
+  }
+
+  void connected(std::size_t idx, error_code ec)
+  {
+    running--;
+    if (!handler) // already done, the attempt lost the race
+      return;
+
+    if (!ec && !cancelled)
+    {
+      // take the winner out before closing the losers.
+      auto fd = attempts[idx].release(ec);
+      cancel();
+      if (!ec)
+        target.assign(endpoints[idx].protocol(), fd, ec);
+      return complete(ec, ec ? endpoint{} : endpoints[idx]);
+    }
+
+    if (!cancelled)
+      last_error = ec;
+    // a failed attempt starts the next one right away
+    timer.cancel();
+    start_next();
+  }
+
+  void cancel()
+  {
+    cancelled = true;
+    timer.cancel();
+    for (auto & a : attempts)
+    {
+      error_code ec;
+      a.close(ec);
+    }
+  }
+
+  void complete(error_code ec, endpoint ep)
+  {
+    if (!handler)
+      return;
+    net::get_associated_cancellation_slot(*handler).clear();
+    auto h = std::move(*handler);
+    handler.reset();
+    std::move(h)(ec, std::move(ep));
+  }
+};
+
+}
+
+void socket::initiate_happy_eyeballs_connect_(void * this_, endpoint_sequence eps, happy_eyeballs options,
+                                              completion_handler<error_code, endpoint> handler)
+{
+  auto sock = static_cast<socket*>(this_);
+  for (auto & ep : eps)
+    sock->adopt_endpoint_(ep);
+
+  std::make_shared<happy_eyeballs_state>(sock->socket_, interleave_families(std::move(eps)),
+                                         options.attempt_delay, std::move(handler))->start();
+}
+
 void socket::try_wait_(void *this_, wait_type wt, handler<error_code> h)
 {
   auto sock = static_cast<socket*>(this_);
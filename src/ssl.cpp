@@ -6,34 +6,73 @@
 //
 
 #include <cobalt/io/ssl.hpp>
+#include <cobalt/io/ssl_session_cache.hpp>
 
 #include <cobalt/io/initiate_templates.hpp>
 #include <cobalt/io/socket.hpp>
 #include <cobalt/io/stream_socket.hpp>
 
+#include <boost/asio/append.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/prefer.hpp>
+#include <boost/cobalt/experimental/composition.hpp>
+
+#include <openssl/kdf.h>
+#include <openssl/ssl.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/tls.h>)
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#define COBALT_IO_HAS_KTLS 1
+
+#if !defined(SOL_TLS)
+#define SOL_TLS 282
+#endif
+
+#if !defined(TCP_ULP)
+#define TCP_ULP 31
+#endif
+#endif
+
 
 namespace cobalt::io
 {
 
-static net::ssl::context & get_ssl_context()
+net::ssl::context & ssl_stream::default_context_()
 {
-  thread_local static net::ssl::context ctx{net::ssl::context_base::tlsv13};
+  thread_local static net::ssl::context ctx = []
+      {
+        net::ssl::context c{net::ssl::context_base::tlsv13};
+        ssl_session_cache::prepare_client_(c.native_handle());
+        return c;
+      }();
   return ctx;
 }
 
 
 ssl_stream::ssl_stream(const cobalt::executor & exec)
-    : ssl_stream_base(exec, get_ssl_context()), socket(ssl_stream_.next_layer())
+    : ssl_stream_base(exec, default_context_()), socket(ssl_stream_.next_layer())
 {
 }
 
 ssl_stream::ssl_stream(ssl_stream && lhs)
-    : ssl_stream_base(std::move(lhs.ssl_stream_)), socket(ssl_stream_.next_layer())
+    : ssl_stream_base(std::move(lhs.ssl_stream_)), socket(ssl_stream_.next_layer()),
+      mode_(std::exchange(lhs.mode_, 0)), handshake_executor_(std::move(lhs.handshake_executor_)), ktls_(std::move(lhs.ktls_)),
+      record_size_(lhs.record_size_), record_buffer_(std::move(lhs.record_buffer_)),
+      warm_up_(lhs.warm_up_), bytes_written_(lhs.bytes_written_), idle_(lhs.idle_), last_write_(lhs.last_write_)
 {
+  if (mode_ & 4)
+    SSL_set_msg_callback_arg(ssl_stream_.native_handle(), this);
 }
 
 ssl_stream::ssl_stream(stream_socket && socket_)
-    : ssl_stream_base(std::move(socket_.stream_socket_), get_ssl_context()), socket(ssl_stream_.next_layer()) {}
+    : ssl_stream_base(std::move(socket_.stream_socket_), default_context_()), socket(ssl_stream_.next_layer()) {}
 
 ssl_stream::ssl_stream(net::ssl::context & ctx, const cobalt::executor & exec)
     : ssl_stream_base(exec, ctx), socket(ssl_stream_.next_layer()) {}
@@ -43,6 +82,259 @@ ssl_stream::ssl_stream(net::ssl::context & ctx, stream_socket && socket_)
 
 
 
+namespace detail
+{
+
+// The application traffic secrets, as handed to the keylog callback.
+struct ktls_state
+{
+  std::vector<unsigned char> client_secret, server_secret;
+
+  ~ktls_state()
+  {
+    OPENSSL_cleanse(client_secret.data(), client_secret.size());
+    OPENSSL_cleanse(server_secret.data(), server_secret.size());
+  }
+};
+
+}
+
+ssl_stream::~ssl_stream()
+{
+  if (ktls_)
+    SSL_set_ex_data(ssl_stream_.native_handle(), ktls_index_(), nullptr);
+}
+
+int ssl_stream::ktls_index_()
+{
+  static const int idx = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return idx;
+}
+
+// the keylog callback that was installed before ours, stored in the SSL_CTX.
+static int ktls_previous_keylog_index()
+{
+  static const int idx = SSL_CTX_get_ex_new_index(
+      0, nullptr, nullptr, nullptr,
+      [](void *, void * ptr, CRYPTO_EX_DATA *, int, long, void *) {OPENSSL_free(ptr);});
+  return idx;
+}
+
+void ssl_stream::ktls_keylog_(const SSL * ssl, const char * line)
+{
+  using keylog_cb = void (*)(const SSL *, const char *);
+  if (auto prev = SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ktls_previous_keylog_index()))
+    (*static_cast<keylog_cb*>(prev))(ssl, line);
+
+  auto st = static_cast<detail::ktls_state*>(SSL_get_ex_data(ssl, ktls_index_()));
+  if (!st)
+    return;
+
+  // <label> <client random> <secret>, all hex
+  std::string_view ln{line};
+  std::vector<unsigned char> * target;
+  if (ln.starts_with("CLIENT_TRAFFIC_SECRET_0 "))
+    target = &st->client_secret;
+  else if (ln.starts_with("SERVER_TRAFFIC_SECRET_0 "))
+    target = &st->server_secret;
+  else
+    return;
+
+  const auto hex = ln.substr(ln.rfind(' ') + 1u);
+  const auto nibble = [](char c) -> unsigned char
+      {
+        return static_cast<unsigned char>(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+      };
+  target->resize(hex.size() / 2u);
+  for (std::size_t i = 0u; i < target->size(); i++)
+    (*target)[i] = static_cast<unsigned char>((nibble(hex[2 * i]) << 4) | nibble(hex[2 * i + 1]));
+}
+
+result<void> ssl_stream::enable_ktls()
+{
+#if defined(COBALT_IO_HAS_KTLS)
+  auto ssl = ssl_stream_.native_handle();
+  auto ctx = SSL_get_SSL_CTX(ssl);
+  // the callback is per context, so it forwards to the one it replaces & ignores streams without kTLS.
+  const auto cb = SSL_CTX_get_keylog_callback(ctx);
+  if (cb != &ktls_keylog_)
+  {
+    if (cb != nullptr)
+    {
+      using keylog_cb = void (*)(const SSL *, const char *);
+      const auto prev = static_cast<keylog_cb*>(OPENSSL_malloc(sizeof(keylog_cb)));
+      if (!prev)
+        return net::error::no_memory;
+      *prev = cb;
+      OPENSSL_free(SSL_CTX_get_ex_data(ctx, ktls_previous_keylog_index()));
+      SSL_CTX_set_ex_data(ctx, ktls_previous_keylog_index(), prev);
+    }
+    SSL_CTX_set_keylog_callback(ctx, &ktls_keylog_);
+  }
+
+  if (!ktls_)
+    ktls_ = std::make_unique<detail::ktls_state>();
+  SSL_set_ex_data(ssl, ktls_index_(), ktls_.get());
+  // session tickets get sent after the handshake, which would leave us with an unknown record sequence number.
+  SSL_set_num_tickets(ssl, 0);
+  return {};
+#else
+  return net::error::operation_not_supported;
+#endif
+}
+
+#if defined(COBALT_IO_HAS_KTLS)
+
+// HKDF-Expand-Label from RFC 8446, with an empty context.
+static bool hkdf_expand_label(const EVP_MD * md, const std::vector<unsigned char> & secret,
+                              std::string_view label, unsigned char * out, std::size_t len)
+{
+  constexpr std::string_view prefix = "tls13 ";
+  unsigned char info[4u + prefix.size() + 16u];
+  std::size_t n = 0u;
+  info[n++] = static_cast<unsigned char>(len >> 8);
+  info[n++] = static_cast<unsigned char>(len);
+  info[n++] = static_cast<unsigned char>(prefix.size() + label.size());
+  n = std::copy(prefix.begin(), prefix.end(), info + n) - info;
+  n = std::copy(label.begin(),  label.end(),  info + n) - info;
+  info[n++] = 0u;
+
+  std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> ctx{EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr),
+                                                                 &EVP_PKEY_CTX_free};
+  return ctx
+      && EVP_PKEY_derive_init(ctx.get()) > 0
+      && EVP_PKEY_CTX_hkdf_mode(ctx.get(), EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0
+      && EVP_PKEY_CTX_set_hkdf_md(ctx.get(), md) > 0
+      && EVP_PKEY_CTX_set1_hkdf_key(ctx.get(), secret.data(), static_cast<int>(secret.size())) > 0
+      && EVP_PKEY_CTX_add1_hkdf_info(ctx.get(), info, static_cast<int>(n)) > 0
+      && EVP_PKEY_derive(ctx.get(), out, &len) > 0;
+}
+
+#endif
+
+void ssl_stream::install_ktls_()
+{
+#if defined(COBALT_IO_HAS_KTLS)
+  auto ssl = ssl_stream_.native_handle();
+  SSL_set_ex_data(ssl, ktls_index_(), nullptr);
+  auto st = std::move(ktls_);
+  if (SSL_version(ssl) != TLS1_3_VERSION)
+    return;
+
+  const auto & secret = SSL_is_server(ssl) ? st->server_secret : st->client_secret;
+  if (secret.empty())
+    return;
+
+  const auto cipher = SSL_get_current_cipher(ssl);
+  const auto md = SSL_CIPHER_get_handshake_digest(cipher);
+
+  union
+  {
+    tls12_crypto_info_aes_gcm_128 aes_128;
+    tls12_crypto_info_aes_gcm_256 aes_256;
+    tls12_crypto_info_chacha20_poly1305 chacha;
+  } info{};
+  std::size_t info_size;
+
+  // the kernel wants the 12 byte nonce split into salt & iv for AES-GCM.
+  unsigned char iv[12];
+  if (!hkdf_expand_label(md, secret, "iv", iv, sizeof(iv)))
+    return;
+
+  switch (SSL_CIPHER_get_id(cipher))
+  {
+    case TLS1_3_CK_AES_128_GCM_SHA256:
+      info.aes_128.info = {TLS_1_3_VERSION, TLS_CIPHER_AES_GCM_128};
+      if (!hkdf_expand_label(md, secret, "key", info.aes_128.key, sizeof(info.aes_128.key)))
+        return;
+      std::copy_n(iv, sizeof(info.aes_128.salt), info.aes_128.salt);
+      std::copy_n(iv + sizeof(info.aes_128.salt), sizeof(info.aes_128.iv), info.aes_128.iv);
+      info_size = sizeof(info.aes_128);
+      break;
+    case TLS1_3_CK_AES_256_GCM_SHA384:
+      info.aes_256.info = {TLS_1_3_VERSION, TLS_CIPHER_AES_GCM_256};
+      if (!hkdf_expand_label(md, secret, "key", info.aes_256.key, sizeof(info.aes_256.key)))
+        return;
+      std::copy_n(iv, sizeof(info.aes_256.salt), info.aes_256.salt);
+      std::copy_n(iv + sizeof(info.aes_256.salt), sizeof(info.aes_256.iv), info.aes_256.iv);
+      info_size = sizeof(info.aes_256);
+      break;
+    case TLS1_3_CK_CHACHA20_POLY1305_SHA256:
+      info.chacha.info = {TLS_1_3_VERSION, TLS_CIPHER_CHACHA20_POLY1305};
+      if (!hkdf_expand_label(md, secret, "key", info.chacha.key, sizeof(info.chacha.key)))
+        return;
+      std::copy_n(iv, sizeof(info.chacha.iv), info.chacha.iv);
+      info_size = sizeof(info.chacha);
+      break;
+    default:
+      return;
+  }
+
+  // no application data has been written, so the record sequence starts at zero.
+  const auto fd = ssl_stream_.next_layer().native_handle();
+  if (::setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0
+      && ::setsockopt(fd, SOL_TLS, TLS_TX, &info, info_size) == 0)
+  {
+    mode_ |= 4;
+    SSL_set_msg_callback(ssl, &ktls_message_);
+    SSL_set_msg_callback_arg(ssl, this);
+  }
+  OPENSSL_cleanse(&info, sizeof(info));
+#endif
+}
+
+error_code ssl_stream::send_ktls_alert_(unsigned char level, unsigned char description)
+{
+#if defined(COBALT_IO_HAS_KTLS)
+  // OpenSSL's alert would get encrypted as application data, so it needs to be sent as an alert record by the kernel.
+  unsigned char alert[2] = {level, description};
+  char control[CMSG_SPACE(sizeof(unsigned char))] = {};
+  iovec iov{alert, sizeof(alert)};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1u;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  auto cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_TLS;
+  cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+  *CMSG_DATA(cmsg) = SSL3_RT_ALERT;
+  if (::sendmsg(ssl_stream_.next_layer().native_handle(), &msg, MSG_NOSIGNAL) < 0)
+    return error_code{errno, boost::system::system_category()};
+  return error_code{};
+#else
+  return net::error::operation_not_supported;
+#endif
+}
+
+// Once TLS_TX is set, whatever OpenSSL writes into its BIO would get encrypted a second time by the kernel.
+// After the handshake that's only an alert or a KeyUpdate raised while reading. Alerts get sent by the kernel instead,
+// a KeyUpdate can't be followed, since the kernel has the keys, so the connection gets closed with an internal_error.
+// Shutting down the write side makes OpenSSL's own copy fail, instead of reaching the peer.
+void ssl_stream::ktls_message_(int write_p, int, int content_type, const void * buf, std::size_t len, SSL *, void * arg)
+{
+#if defined(COBALT_IO_HAS_KTLS)
+  auto t = static_cast<ssl_stream*>(arg);
+  if (!write_p || (t->mode_ & 5) != 5 || (content_type != SSL3_RT_ALERT && content_type != SSL3_RT_HANDSHAKE))
+    return;
+
+  const auto bytes = static_cast<const unsigned char*>(buf);
+  if (content_type == SSL3_RT_ALERT && len == 2u)
+    t->send_ktls_alert_(bytes[0], bytes[1]);
+  else
+    t->send_ktls_alert_(SSL3_AL_FATAL, SSL_AD_INTERNAL_ERROR);
+
+  ::shutdown(t->ssl_stream_.next_layer().native_handle(), SHUT_WR);
+  t->mode_ &= ~1;
+#endif
+}
+
+void ssl_stream::use_session_cache(ssl_session_cache & cache, std::string_view key)
+{
+  cache.bind_(ssl_stream_.native_handle(), key);
+}
+
 void ssl_stream::adopt_endpoint_(endpoint & ep)
 {
 
@@ -68,18 +360,60 @@ void ssl_stream::initiate_read_some_(void *this_ , mutable_buffer_sequence buffe
 
 }
 
+std::size_t ssl_stream::record_limit_()
+{
+  if (warm_up_ == 0u)
+    return record_size_;
+
+  const auto now = std::chrono::steady_clock::now();
+  if ((now - last_write_) > idle_) // the congestion window is likely gone, so start small again
+    bytes_written_ = 0u;
+  last_write_ = now;
+  return bytes_written_ < warm_up_ ? (std::min)(small_record_size, record_size_) : record_size_;
+}
+
 void ssl_stream::initiate_write_some_   (void * this_, const_buffer_sequence buffer, boost::cobalt::completion_handler<error_code, std::size_t> handler)
 {
   auto th = static_cast<ssl_stream*>(this_);
-  if (th->mode_ == 3)
-    initiate_async_write_some(th->ssl_stream_.next_layer(), buffer, std::move(handler));
+  // kTLS after shutdown or a fatal alert.
+  if ((th->mode_ & 5) == 4)
+    return handler(net::error::shut_down, 0u);
+  if (th->mode_ == 3 || (th->mode_ & 4))
+    return initiate_async_write_some(th->ssl_stream_.next_layer(), buffer, std::move(handler));
+
+  const auto limit = th->record_limit_();
+  auto d = boost::asio::deferred(
+      [th](error_code ec, std::size_t n)
+      {
+        th->bytes_written_ += n;
+        return boost::asio::deferred.values(ec, n);
+      });
+
+  // asio would only encrypt the first buffer, so gather everything into one record.
+  if (!buffer.tail.empty() && !buffer.is_registered())
+  {
+    if (!th->record_buffer_)
+      th->record_buffer_.reset(new unsigned char[max_record_size]);
+    const auto n = net::buffer_copy(net::buffer(th->record_buffer_.get(), limit), buffer);
+    th->ssl_stream_.async_write_some(net::buffer(th->record_buffer_.get(), n), d)(std::move(handler));
+  }
+  else if (buffer.is_registered())
+    th->ssl_stream_.async_write_some(net::buffer(buffer.registered, limit), d)(std::move(handler));
   else
-    initiate_async_write_some(th->ssl_stream_,              buffer, std::move(handler));
+    th->ssl_stream_.async_write_some(net::buffer(buffer.head, limit), d)(std::move(handler));
 }
 
 void ssl_stream::initiate_shutdown_(void * this_, boost::cobalt::completion_handler<error_code> handler)
 {
   auto t = static_cast<ssl_stream*>(this_);
+  if (t->mode_ & 4)
+  {
+    if ((t->mode_ & 1) == 0)
+      return handler(net::error::shut_down);
+    // kTLS stays active, so writes after this fail instead of going through OpenSSL.
+    t->mode_ &= ~1;
+    return handler(t->send_ktls_alert_(SSL3_AL_WARNING, SSL_AD_CLOSE_NOTIFY));
+  }
   t->ssl_stream_.async_shutdown(
       boost::asio::deferred(
           [t](error_code ec)
@@ -90,15 +424,51 @@ void ssl_stream::initiate_shutdown_(void * this_, boost::cobalt::completion_hand
           }))(std::move(handler));
 }
 
+void ssl_stream::handshake_completed_(error_code ec)
+{
+  if (ec)
+    return;
+  mode_ |= 1;
+  if (ktls_)
+    install_ktls_();
+}
+
+// The intermediate handlers of the handshake run on the worker, which is where OpenSSL does the crypto.
+// The result gets posted back to the executor of the awaiting coroutine, which is kept from running out of work meanwhile.
+template<typename ... Args>
+static auto offload_handshake_to(const executor & worker, ssl_stream * t,
+                                 void (ssl_stream::*done)(error_code),
+                                 completion_handler<error_code, Args...> handler)
+{
+  auto tracked = net::prefer(net::get_associated_executor(handler), net::execution::outstanding_work.tracked);
+  return net::bind_executor(
+      worker,
+      [t, done, tracked = std::move(tracked), h = std::move(handler)](error_code ec, Args ... args) mutable
+      {
+        (t->*done)(ec);
+        net::post(tracked, net::append(std::move(h), ec, args...));
+      });
+}
+
 void ssl_stream::initiate_handshake_(void *this_, handshake_type ht, boost::cobalt::completion_handler<error_code> handler)
 {
   auto t = static_cast<ssl_stream*>(this_);
+  if (t->handshake_executor_)
+  {
+    auto worker = *t->handshake_executor_;
+    return net::post(
+        worker,
+        [t, ht, tk = offload_handshake_to(worker, t, &ssl_stream::handshake_completed_, std::move(handler))]() mutable
+        {
+          t->ssl_stream_.async_handshake(ht, std::move(tk));
+        });
+  }
+
   t->ssl_stream_.async_handshake(
       ht, boost::asio::deferred(
           [t](error_code ec)
           {
-            if (!ec)
-              t->mode_ |= 1;
+            t->handshake_completed_(ec);
             return boost::asio::deferred.values(ec);
           }))(std::move(handler));
 }
@@ -109,11 +479,24 @@ void ssl_stream::initiate_buffered_handshake_(void * this_, handshake_type ht, c
   auto t = static_cast<ssl_stream*>(this_);
   auto & str = t->ssl_stream_;
 
+  if (t->handshake_executor_)
+  {
+    auto worker = *t->handshake_executor_;
+    return net::post(
+        worker,
+        [t, ht, seq, tk = offload_handshake_to(worker, t, &ssl_stream::handshake_completed_, std::move(handler))]() mutable
+        {
+          if (seq.buffer_count() > 0u)
+            t->ssl_stream_.async_handshake(ht, seq, std::move(tk));
+          else
+            t->ssl_stream_.async_handshake(ht, seq.head, std::move(tk));
+        });
+  }
+
   auto d = boost::asio::deferred(
               [t](error_code ec, std::size_t n)
               {
-                if (!ec)
-                  t->mode_ |= 1;
+                t->handshake_completed_(ec);
                 return boost::asio::deferred.values(ec, n);
               });
 
@@ -123,6 +506,30 @@ void ssl_stream::initiate_buffered_handshake_(void * this_, handshake_type ht, c
     str.async_handshake(ht, seq.head, d)(std::move(handler));
 }
 
+void ssl_stream::initiate_detect_handshake_(void * this_, handshake_type ht, boost::cobalt::completion_handler<error_code, bool>)
+{
+  auto t = static_cast<ssl_stream*>(this_);
+  auto & sock = t->ssl_stream_.next_layer();
+
+  auto [ec] = co_await t->wait(wait_type::wait_read);
+  if (ec)
+    co_return {ec, false};
+
+  // a TLS connection starts with a handshake record, no plain text protocol starts with 0x16.
+  unsigned char head = 0u;
+  sock.receive(net::buffer(&head, 1u), message_peek, ec);
+  if (ec)
+    co_return {ec, false};
+
+  if (head != 0x16)
+  {
+    t->mode_ |= 3;
+    co_return {{}, false};
+  }
 
+  t->mode_ &= ~2;
+  std::tie(ec) = co_await t->handshake(ht);
+  co_return {ec, !ec};
+}
 
 }
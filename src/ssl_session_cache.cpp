@@ -0,0 +1,344 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <cobalt/io/ssl_session_cache.hpp>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
+
+#include <algorithm>
+#include <ctime>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cobalt::io
+{
+
+struct ssl_session_cache::shard_
+{
+  struct entry
+  {
+    std::string key;
+    SSL_SESSION * session;
+  };
+
+  mutable std::mutex mtx;
+  // most recently used first, the index points into the keys of the list.
+  std::list<entry> lru;
+  std::unordered_map<std::string_view, std::list<entry>::iterator> index;
+
+  void erase(std::list<entry>::iterator itr)
+  {
+    index.erase(itr->key);
+    SSL_SESSION_free(itr->session);
+    lru.erase(itr);
+  }
+};
+
+namespace
+{
+
+// the key a client stream stores its sessions under. The stream might outlive the cache.
+struct binding
+{
+  std::shared_ptr<const bool> alive;
+  ssl_session_cache * cache;
+  std::string key;
+};
+
+void free_binding(void *, void * ptr, CRYPTO_EX_DATA *, int, long, void *)
+{
+  delete static_cast<binding*>(ptr);
+}
+
+int ctx_index()
+{
+  static const int idx = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return idx;
+}
+
+int ssl_index()
+{
+  static const int idx = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, &free_binding);
+  return idx;
+}
+
+std::string_view session_id(const SSL_SESSION * session)
+{
+  unsigned int len = 0u;
+  auto id = SSL_SESSION_get_id(session, &len);
+  return {reinterpret_cast<const char*>(id), len};
+}
+
+}
+
+ssl_session_cache::ssl_session_cache(std::size_t capacity, std::size_t shards,
+                                     std::chrono::seconds ticket_key_lifetime)
+    : shard_count_((std::max)(shards, std::size_t(1u))),
+      shard_capacity_((std::max)(capacity / shard_count_, std::size_t(1u))),
+      shards_(std::make_unique<shard_[]>(shard_count_)),
+      ticket_key_lifetime_(ticket_key_lifetime)
+{
+  make_ticket_key_(current_key_);
+  previous_key_ = current_key_;
+}
+
+ssl_session_cache::~ssl_session_cache()
+{
+  *alive_ = false;
+  // the contexts might outlive the cache, so they must not find it anymore.
+  for (auto c : attached_)
+  {
+    if (SSL_CTX_get_ex_data(c, ctx_index()) == this)
+    {
+      SSL_CTX_set_ex_data(c, ctx_index(), nullptr);
+      SSL_CTX_sess_set_get_cb(c, nullptr);
+      SSL_CTX_sess_set_remove_cb(c, nullptr);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+      SSL_CTX_set_tlsext_ticket_key_evp_cb(c, nullptr);
+#endif
+    }
+    SSL_CTX_free(c);
+  }
+  clear();
+}
+
+auto ssl_session_cache::shard_for_(std::string_view key) const -> shard_ &
+{
+  return shards_[std::hash<std::string_view>{}(key) % shard_count_];
+}
+
+bool ssl_session_cache::insert(std::string_view key, SSL_SESSION * session)
+{
+  if (!SSL_SESSION_is_resumable(session))
+    return false;
+
+  auto & sh = shard_for_(key);
+  std::lock_guard<std::mutex> lock{sh.mtx};
+  SSL_SESSION_up_ref(session);
+
+  auto itr = sh.index.find(key);
+  if (itr != sh.index.end())
+  {
+    SSL_SESSION_free(itr->second->session);
+    itr->second->session = session;
+    sh.lru.splice(sh.lru.begin(), sh.lru, itr->second);
+    return true;
+  }
+
+  sh.lru.push_front({std::string(key), session});
+  sh.index.emplace(sh.lru.front().key, sh.lru.begin());
+  while (sh.lru.size() > shard_capacity_)
+    sh.erase(std::prev(sh.lru.end()));
+  return true;
+}
+
+SSL_SESSION * ssl_session_cache::find(std::string_view key)
+{
+  auto & sh = shard_for_(key);
+  std::lock_guard<std::mutex> lock{sh.mtx};
+  auto itr = sh.index.find(key);
+  if (itr == sh.index.end())
+    return nullptr;
+
+  auto session = itr->second->session;
+  if (std::time(nullptr) >= (SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session)))
+  {
+    sh.erase(itr->second);
+    return nullptr;
+  }
+
+  sh.lru.splice(sh.lru.begin(), sh.lru, itr->second);
+  SSL_SESSION_up_ref(session);
+  return session;
+}
+
+void ssl_session_cache::erase(std::string_view key)
+{
+  auto & sh = shard_for_(key);
+  std::lock_guard<std::mutex> lock{sh.mtx};
+  auto itr = sh.index.find(key);
+  if (itr != sh.index.end())
+    sh.erase(itr->second);
+}
+
+void ssl_session_cache::clear()
+{
+  for (std::size_t i = 0u; i < shard_count_; i++)
+  {
+    auto & sh = shards_[i];
+    std::lock_guard<std::mutex> lock{sh.mtx};
+    for (auto & e : sh.lru)
+      SSL_SESSION_free(e.session);
+    sh.index.clear();
+    sh.lru.clear();
+  }
+}
+
+std::size_t ssl_session_cache::size() const
+{
+  std::size_t n = 0u;
+  for (std::size_t i = 0u; i < shard_count_; i++)
+  {
+    auto & sh = shards_[i];
+    std::lock_guard<std::mutex> lock{sh.mtx};
+    n += sh.lru.size();
+  }
+  return n;
+}
+
+void ssl_session_cache::make_ticket_key_(ticket_key_ & key)
+{
+  RAND_bytes(key.name,     sizeof(key.name));
+  RAND_bytes(key.aes_key,  sizeof(key.aes_key));
+  RAND_bytes(key.hmac_key, sizeof(key.hmac_key));
+  key.created = std::chrono::steady_clock::now();
+}
+
+void ssl_session_cache::rotate_ticket_keys()
+{
+  std::lock_guard<std::mutex> lock{ticket_mutex_};
+  previous_key_ = current_key_;
+  make_ticket_key_(current_key_);
+}
+
+void ssl_session_cache::attach(net::ssl::context & ctx)
+{
+  auto c = ctx.native_handle();
+  // keeps the SSL_CTX around, so the destructor can detach from it.
+  if (std::find(attached_.begin(), attached_.end(), c) == attached_.end())
+  {
+    SSL_CTX_up_ref(c);
+    attached_.push_back(c);
+  }
+  SSL_CTX_set_ex_data(c, ctx_index(), this);
+  prepare_client_(c);
+  SSL_CTX_set_session_cache_mode(c, SSL_CTX_get_session_cache_mode(c)
+                                      | SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+  SSL_CTX_sess_set_get_cb(c, &get_session_);
+  SSL_CTX_sess_set_remove_cb(c, &remove_session_);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  SSL_CTX_set_tlsext_ticket_key_evp_cb(c, &ticket_key_callback_);
+#endif
+}
+
+// the callback finds the cache through the SSL's binding, so it's harmless for streams that don't use one.
+void ssl_session_cache::prepare_client_(SSL_CTX * ctx)
+{
+  SSL_CTX_set_session_cache_mode(ctx, SSL_CTX_get_session_cache_mode(ctx) | SSL_SESS_CACHE_CLIENT);
+  SSL_CTX_sess_set_new_cb(ctx, &new_session_);
+}
+
+// only touches the SSL, since the context might be shared with other threads.
+void ssl_session_cache::bind_(SSL * ssl, std::string_view key)
+{
+  BOOST_ASSERT_MSG(SSL_CTX_sess_get_new_cb(SSL_get_SSL_CTX(ssl)) == &new_session_,
+                   "the context needs to be attached to a session cache");
+
+  delete static_cast<binding*>(SSL_get_ex_data(ssl, ssl_index()));
+  SSL_set_ex_data(ssl, ssl_index(), new binding{alive_, this, std::string(key)});
+
+  if (auto session = find(key))
+  {
+    SSL_set_session(ssl, session);
+    // TLS 1.3 tickets are single use, the server sends new ones after resuming.
+    if (SSL_SESSION_get_protocol_version(session) == TLS1_3_VERSION)
+      erase(key);
+    SSL_SESSION_free(session);
+  }
+}
+
+int ssl_session_cache::new_session_(SSL * ssl, SSL_SESSION * session)
+{
+  if (SSL_is_server(ssl))
+  {
+    auto cache = static_cast<ssl_session_cache*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ctx_index()));
+    if (cache)
+      cache->insert(session_id(session), session);
+  }
+  else if (auto b = static_cast<binding*>(SSL_get_ex_data(ssl, ssl_index())); b && *b->alive)
+    b->cache->insert(b->key, session);
+
+  // insert takes its own reference
+  return 0;
+}
+
+SSL_SESSION * ssl_session_cache::get_session_(SSL * ssl, const unsigned char * id, int len, int * copy)
+{
+  *copy = 0;
+  auto cache = static_cast<ssl_session_cache*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ctx_index()));
+  if (!cache)
+    return nullptr;
+  return cache->find({reinterpret_cast<const char*>(id), static_cast<std::size_t>(len)});
+}
+
+void ssl_session_cache::remove_session_(SSL_CTX * ctx, SSL_SESSION * session)
+{
+  if (auto cache = static_cast<ssl_session_cache*>(SSL_CTX_get_ex_data(ctx, ctx_index())))
+    cache->erase(session_id(session));
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+int ssl_session_cache::ticket_key_callback_(SSL * ssl, unsigned char * key_name, unsigned char * iv,
+                                            EVP_CIPHER_CTX * cctx, EVP_MAC_CTX * hctx, int enc)
+{
+  auto cache = static_cast<ssl_session_cache*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ctx_index()));
+  if (!cache)
+    return -1;
+
+  std::lock_guard<std::mutex> lock{cache->ticket_mutex_};
+  const ticket_key_ * key;
+  int res = 1;
+  if (enc)
+  {
+    if ((std::chrono::steady_clock::now() - cache->current_key_.created) > cache->ticket_key_lifetime_)
+    {
+      cache->previous_key_ = cache->current_key_;
+      make_ticket_key_(cache->current_key_);
+    }
+    key = &cache->current_key_;
+    if (RAND_bytes(iv, EVP_CIPHER_get_iv_length(EVP_aes_256_cbc())) <= 0)
+      return -1;
+    std::copy(std::begin(key->name), std::end(key->name), key_name);
+  }
+  else if (std::equal(std::begin(cache->current_key_.name), std::end(cache->current_key_.name), key_name))
+    key = &cache->current_key_;
+  else if (std::equal(std::begin(cache->previous_key_.name), std::end(cache->previous_key_.name), key_name))
+  {
+    key = &cache->previous_key_;
+    res = 2; // valid, but issue a new ticket with the current key
+  }
+  else
+    return 0;
+
+  OSSL_PARAM params[] = {
+      OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, const_cast<unsigned char*>(key->hmac_key),
+                                        sizeof(key->hmac_key)),
+      OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>("SHA256"), 0),
+      OSSL_PARAM_construct_end()
+  };
+  if (!EVP_MAC_CTX_set_params(hctx, params))
+    return -1;
+
+  const auto ok = enc ? EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), nullptr, key->aes_key, iv)
+                      : EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), nullptr, key->aes_key, iv);
+  return ok ? res : -1;
+}
+
+#endif
+
+}
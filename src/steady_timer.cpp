@@ -9,44 +9,90 @@
 
 #include <boost/asio/redirect_error.hpp>
 
+#include <bit>
+
 namespace cobalt::io
 {
 
-steady_timer::steady_timer(const cobalt::executor & executor) : timer_(executor) {}
-steady_timer::steady_timer(const time_point &expiry_time, const cobalt::executor & executor) : timer_(executor, expiry_time) {}
-steady_timer::steady_timer(const duration &expiry_time, const cobalt::executor & executor) : timer_(executor, expiry_time) {}
+namespace
+{
+
+// the point in [expiry, expiry + slack] with the most trailing zero bits,
+// so timers with overlapping windows end up on the same expiry.
+steady_timer::time_point coalesce(steady_timer::time_point expiry, steady_timer::duration slack)
+{
+  using rep = std::make_unsigned_t<steady_timer::duration::rep>;
+  const auto lo = static_cast<rep>(expiry.time_since_epoch().count());
+  if (slack <= steady_timer::duration::zero() || lo == 0u)
+    return expiry;
+
+  const auto hi = lo + static_cast<rep>(slack.count());
+  const auto res = hi & ~(std::bit_floor(hi ^ (lo - 1u)) - 1u);
+  return steady_timer::time_point(steady_timer::duration(static_cast<steady_timer::duration::rep>(res)));
+}
+
+}
+
+steady_timer::steady_timer(const cobalt::executor & executor) : timer_(std::in_place, executor) {}
+steady_timer::steady_timer(const time_point &expiry_time, const cobalt::executor & executor) : timer_(std::in_place, executor, expiry_time) {}
+steady_timer::steady_timer(const duration &expiry_time, const cobalt::executor & executor) : timer_(std::in_place, executor, expiry_time) {}
+
+steady_timer::steady_timer(timer_wheel & wheel) : wheel_(&wheel) {}
+steady_timer::steady_timer(const time_point &expiry_time, timer_wheel & wheel)
+    : wheel_(&wheel), wheel_expiry_(expiry_time) {}
+// not the wheel's clock, which lags when it's coarse & would make the timer fire early.
+steady_timer::steady_timer(const duration &expiry_time, timer_wheel & wheel)
+    : wheel_(&wheel), wheel_expiry_(clock_type::now() + expiry_time) {}
 
 void steady_timer::cancel()
 {
-  timer_.cancel();
+  if (wheel_)
+    wheel_->cancel(entry_);
+  else
+    timer_->cancel();
 }
 
 
 auto steady_timer::expiry() const -> time_point
 {
-  return timer_.expiry();
+  if (wheel_)
+    return wheel_expiry_;
+  return timer_->expiry();
 }
 
 void steady_timer::reset(const time_point &expiry_time)
 {
-  timer_.expires_at(expiry_time);
+  if (wheel_)
+  {
+    wheel_->cancel(entry_);
+    wheel_expiry_ = coalesce(expiry_time, slack_);
+  }
+  else
+    timer_->expires_at(coalesce(expiry_time, slack_));
 }
 
 void steady_timer::reset(const duration &expiry_time)
 {
-  timer_.expires_after(expiry_time);
+  reset(clock_type::now() + expiry_time);
 }
 
-bool steady_timer::expired() const { return timer_.expiry() < clock_type::now(); }
+bool steady_timer::expired() const { return expiry() < clock_type::now(); }
 
 void steady_timer::initiate_wait_(void * this_, boost::cobalt::completion_handler<error_code> handler)
 {
-  static_cast<steady_timer*>(this_)->timer_.async_wait(std::move(handler));
+  auto t = static_cast<steady_timer*>(this_);
+  if (t->wheel_)
+  {
+    t->wheel_->cancel(t->entry_);
+    t->wheel_->async_wait(t->entry_, t->wheel_expiry_, std::move(handler));
+  }
+  else
+    t->timer_->async_wait(std::move(handler));
 }
 
 void steady_timer::try_wait_(void * this_, boost::cobalt::handler<error_code> h)
 {
-  if (static_cast<steady_timer*>(this_)->timer_.expiry()
+  if (static_cast<steady_timer*>(this_)->expiry()
     < std::chrono::steady_clock::now())
     h({});
 }
@@ -5,6 +5,7 @@
 // file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 //
 
+#include <cobalt/io/blocking_pool.hpp>
 #include <cobalt/io/initiate_templates.hpp>
 #include <cobalt/io/stream_file.hpp>
 
@@ -102,7 +103,7 @@ stream_file::stream_file(stream_file && sf) noexcept = default;
 
 result<void> stream_file::resize(std::uint64_t n)
 {
-  if (!::ftruncate(native_handle(), n))
+  if (::ftruncate(native_handle(), n) == -1)
     COBALT_RETURN_ERROR();
 
   return {};
@@ -110,19 +111,20 @@ result<void> stream_file::resize(std::uint64_t n)
 
 result<std::uint64_t> stream_file::seek(std::int64_t offset, seek_basis whence)
 {
-  if (::lseek64(native_handle(), offset, whence) < 0)
+  const auto n = ::lseek64(native_handle(), offset, whence);
+  if (n < 0)
     COBALT_RETURN_ERROR();
 
-  return {};
+  return static_cast<std::uint64_t>(n);
 }
 
 void stream_file::initiate_read_some_(void * this_, mutable_buffer_sequence buffer, boost::cobalt::completion_handler<error_code, std::size_t> handler)
 {
-  initiate_async_read_some(static_cast<stream_file*>(this_)->file_, buffer, std::move(handler));
+  blocking_read_some(static_cast<stream_file*>(this_)->native_handle(), buffer, std::move(handler));
 }
 void stream_file::initiate_write_some_(void * this_, const_buffer_sequence buffer, boost::cobalt::completion_handler<error_code, std::size_t> handler)
 {
-  initiate_async_write_some(static_cast<stream_file*>(this_)->file_, buffer, std::move(handler));
+  blocking_write_some(static_cast<stream_file*>(this_)->native_handle(), buffer, std::move(handler));
 }
 
 #endif
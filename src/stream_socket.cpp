@@ -8,6 +8,15 @@
 #include <cobalt/io/stream_socket.hpp>
 #include <cobalt/io/initiate_templates.hpp>
 
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/container/static_vector.hpp>
+
+#include <deque>
+#include <utility>
+#include <vector>
+
 namespace cobalt::io
 {
 
@@ -22,14 +31,196 @@ stream_socket::stream_socket(native_handle_type h, protocol_type protocol, const
 }
 
 stream_socket::stream_socket(stream_socket && lhs)
-    : socket(stream_socket_), stream_socket_(std::move(lhs.stream_socket_))
+    : socket(stream_socket_), stream_socket_(std::move(lhs.stream_socket_)), cork_(std::move(lhs.cork_))
 {
+  if (cork_)
+    cork_->socket = &stream_socket_;
 }
 stream_socket::stream_socket(endpoint ep, const cobalt::executor & exec)
     : socket(stream_socket_), stream_socket_(exec, ep)
 {
 }
 
+// The cork state is shared with the background flush, so it can outlive the socket.
+struct stream_socket::cork_state_
+{
+  net::basic_stream_socket<protocol_type, executor> * socket;
+  std::size_t limit;
+  bool corked = true;
+  bool flush_scheduled = false;
+  bool flushing = false;
+  error_code error;
+
+  // pending gets appended to, in_flight is owned by whatever write is running.
+  std::vector<unsigned char> pending, in_flight;
+
+  // write_somes & uncorks that need to wait for the running write, in order.
+  std::deque<std::pair<const_buffer_sequence, completion_handler<error_code, std::size_t>>> waiting;
+
+  cork_state_(net::basic_stream_socket<protocol_type, executor> * socket, std::size_t limit)
+      : socket(socket), limit(limit)
+  {
+    pending.reserve(limit);
+    in_flight.reserve(limit);
+  }
+
+  static void flush(std::shared_ptr<cork_state_> st);
+  static void write(std::shared_ptr<cork_state_> st, const_buffer_sequence buffer,
+                    completion_handler<error_code, std::size_t> handler);
+};
+
+void stream_socket::cork_state_::flush(std::shared_ptr<cork_state_> st)
+{
+  if (st->flushing || !st->socket)
+    return;
+
+  if (st->pending.empty() || st->error)
+  {
+    // a waiter that completes right away doesn't start a write, so the next one can go too.
+    while (!st->waiting.empty() && !st->flushing && (st->pending.empty() || st->error))
+    {
+      auto [buffer, h] = std::move(st->waiting.front());
+      st->waiting.pop_front();
+      write(st, buffer, std::move(h));
+    }
+    return;
+  }
+
+  st->flushing = true;
+  std::swap(st->pending, st->in_flight);
+  auto & sock = *st->socket;
+  auto buffer = net::buffer(st->in_flight);
+  net::async_write(
+      sock, buffer,
+      [st = std::move(st)](error_code ec, std::size_t) mutable
+      {
+        st->flushing = false;
+        st->in_flight.clear();
+        if (ec && !st->error)
+          st->error = ec;
+        flush(std::move(st));
+      });
+}
+
+void stream_socket::cork_state_::write(std::shared_ptr<cork_state_> st, const_buffer_sequence buffer,
+                                       completion_handler<error_code, std::size_t> handler)
+{
+  if (st->error)
+    return handler(std::exchange(st->error, error_code{}), 0u);
+
+  const auto n = net::buffer_size(buffer);
+  // an empty write is an uncork, which needs everything to be written out.
+  if (st->flushing || !st->waiting.empty() || (n == 0u && !st->pending.empty()))
+  {
+    st->waiting.emplace_back(buffer, std::move(handler));
+    return flush(std::move(st));
+  }
+
+  if (n == 0u)
+    return handler({}, 0u);
+
+  // queued data & the new buffers go out in one writev. The queue moves to in_flight,
+  // so writes that get corked in the meantime can't reallocate it underneath the socket.
+  std::swap(st->pending, st->in_flight);
+  const auto queued = st->in_flight.size();
+  boost::container::static_vector<net::const_buffer, 16u> seq;
+  if (queued > 0u)
+    seq.push_back(net::buffer(st->in_flight));
+  for (auto itr = buffer.begin(); itr != buffer.end() && seq.size() < seq.capacity(); itr++)
+    seq.push_back(*itr);
+
+  st->flushing = true;
+  auto & sock = *st->socket;
+  auto slot = net::get_associated_cancellation_slot(handler);
+  sock.async_write_some(
+      seq,
+      net::bind_cancellation_slot(
+          slot,
+          [st = std::move(st), queued, buffer, handler = std::move(handler)](error_code ec, std::size_t written) mutable
+          {
+            const auto m = (std::min)(written, queued);
+            // whatever's left of the queue goes in front of what got corked meanwhile.
+            st->in_flight.erase(st->in_flight.begin(), st->in_flight.begin() + m);
+            st->in_flight.insert(st->in_flight.end(), st->pending.begin(), st->pending.end());
+            std::swap(st->pending, st->in_flight);
+            st->in_flight.clear();
+            st->flushing = false;
+
+            // none of the caller's bytes went out yet, so it waits for the rest of the queue
+            // instead of completing with zero bytes. It still goes before any later writer.
+            if (!ec && written <= queued)
+            {
+              st->waiting.emplace_front(buffer, std::move(handler));
+              return flush(std::move(st));
+            }
+
+            flush(st);
+            handler(ec, written - m);
+          }));
+}
+
+stream_socket::~stream_socket()
+{
+  if (cork_)
+    cork_->socket = nullptr;
+}
+
+void stream_socket::cork(std::size_t limit)
+{
+  if (cork_)
+  {
+    cork_->corked = true;
+    cork_->limit = limit;
+  }
+  else
+    cork_ = std::make_shared<cork_state_>(&stream_socket_, limit);
+}
+
+bool stream_socket::corked() const
+{
+  return cork_ && cork_->corked;
+}
+
+void stream_socket::try_write_some_(void * this_, const_buffer_sequence buffer, handler<error_code, std::size_t> h)
+{
+  auto & st = static_cast<stream_socket*>(this_)->cork_;
+  if (!st || !st->corked || st->error || !st->waiting.empty())
+    return;
+
+  const auto n = net::buffer_size(buffer);
+  if (st->pending.size() + n > st->limit)
+    return;
+
+  for (const net::const_buffer & b : buffer)
+  {
+    auto p = static_cast<const unsigned char*>(b.data());
+    st->pending.insert(st->pending.end(), p, p + b.size());
+  }
+
+  // the post runs once the current coroutine suspends, i.e. after all writes of this resumption.
+  if (!st->flush_scheduled && !st->flushing)
+  {
+    st->flush_scheduled = true;
+    net::post(st->socket->get_executor(),
+              [st]
+              {
+                st->flush_scheduled = false;
+                cork_state_::flush(st);
+              });
+  }
+  h({}, n);
+}
+
+void stream_socket::initiate_uncork_(void * this_, const_buffer_sequence, completion_handler<error_code, std::size_t> handler)
+{
+  auto th = static_cast<stream_socket*>(this_);
+  if (!th->cork_)
+    return handler({}, 0u);
+
+  th->cork_->corked = false;
+  cork_state_::write(th->cork_, {}, std::move(handler));
+}
+
 
 
 void stream_socket::adopt_endpoint_(endpoint & ep)
@@ -55,7 +246,10 @@ void stream_socket::initiate_read_some_(void *this_ , mutable_buffer_sequence bu
 }
 void stream_socket::initiate_write_some_   (void * this_, const_buffer_sequence buffer, boost::cobalt::completion_handler<error_code, std::size_t> handler)
 {
-    initiate_async_write_some(static_cast<stream_socket*>(this_)->stream_socket_, buffer, std::move(handler));
+    auto th = static_cast<stream_socket*>(this_);
+    if (th->cork_ && (th->cork_->corked || th->cork_->flushing || !th->cork_->pending.empty() || !th->cork_->waiting.empty()))
+      return cork_state_::write(th->cork_, buffer, std::move(handler));
+    initiate_async_write_some(th->stream_socket_, buffer, std::move(handler));
 
 }
 
@@ -7,7 +7,20 @@
 
 #include <cobalt/io/system_timer.hpp>
 
+#include <boost/asio/append.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/asio/redirect_error.hpp>
+#include <boost/system/system_error.hpp>
+#include <boost/throw_exception.hpp>
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
 
 namespace cobalt::io
 {
@@ -16,37 +29,108 @@ system_timer::system_timer(const cobalt::executor & executor) : timer_(executor)
 system_timer::system_timer(const time_point &expiry_time, const cobalt::executor & executor) : timer_(executor, expiry_time) {}
 system_timer::system_timer(const duration &expiry_time, const cobalt::executor & executor) : timer_(executor, expiry_time) {}
 
+#if defined(__linux__)
+system_timer::system_timer(use_timerfd_t, const cobalt::executor & executor) : system_timer(use_timerfd, time_point{}, executor) {}
+system_timer::system_timer(use_timerfd_t, const time_point &expiry_time, const cobalt::executor & executor)
+    : timer_(executor), expiry_(expiry_time)
+{
+  const int fd = ::timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd < 0)
+    BOOST_THROW_EXCEPTION(boost::system::system_error(error_code(errno, boost::system::system_category()), "timerfd_create"));
+  fd_.emplace(executor, fd);
+}
+#else
+system_timer::system_timer(use_timerfd_t, const cobalt::executor & executor) : timer_(executor) {}
+system_timer::system_timer(use_timerfd_t, const time_point &expiry_time, const cobalt::executor & executor)
+    : timer_(executor, expiry_time) {}
+#endif
+
 void system_timer::cancel()
 {
+#if defined(__linux__)
+  if (fd_)
+    fd_->cancel();
+#endif
   timer_.cancel();
 }
 
 auto system_timer::expiry() const -> time_point
 {
+#if defined(__linux__)
+  if (fd_)
+    return expiry_;
+#endif
   return timer_.expiry();
 }
 
 void system_timer::reset(const time_point &expiry_time)
 {
+#if defined(__linux__)
+  if (fd_)
+  {
+    fd_->cancel();
+    expiry_ = expiry_time;
+    return;
+  }
+#endif
   timer_.expires_at(expiry_time);
 }
 
 void system_timer::reset(const duration &expiry_time)
 {
+#if defined(__linux__)
+  if (fd_)
+    return reset(clock_type::now() + expiry_time);
+#endif
   timer_.expires_after(expiry_time);
 }
 
-bool system_timer::expired() const { return timer_.expiry() < clock_type::now(); }
+bool system_timer::expired() const { return expiry() < clock_type::now(); }
 
 
 void system_timer::initiate_wait_(void * this_, boost::cobalt::completion_handler<error_code> handler)
 {
-  static_cast<system_timer*>(this_)->timer_.async_wait(std::move(handler));
+  auto t = static_cast<system_timer*>(this_);
+#if defined(__linux__)
+  if (t->fd_)
+  {
+    // armed on every wait, an expiry of zero would disarm it.
+    const auto since_epoch = std::max(t->expiry_.time_since_epoch(), duration(1));
+    const auto sec = std::chrono::floor<std::chrono::seconds>(since_epoch);
+    itimerspec spec{};
+    spec.it_value.tv_sec  = static_cast<time_t>(sec.count());
+    spec.it_value.tv_nsec = static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch - sec).count());
+
+    const int fd = t->fd_->native_handle();
+    if (::timerfd_settime(fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, nullptr) != 0)
+      return net::post(net::append(std::move(handler), error_code(errno, boost::system::system_category())));
+
+    t->fd_->async_wait(
+        net::posix::descriptor_base::wait_read,
+        net::deferred(
+            [t, fd](error_code ec)
+            {
+              std::uint64_t expirations;
+              if (!ec && ::read(fd, &expirations, sizeof(expirations)) < 0)
+              {
+                const int err = errno;
+                // ECANCELED means the clock got set, EAGAIN that it got rearmed for a later expiry.
+                if (err == ECANCELED || (err == EAGAIN && t->expiry_ > clock_type::now()))
+                  ec = net::error::interrupted;
+                else if (err != EAGAIN)
+                  ec.assign(err, boost::system::system_category());
+              }
+              return net::deferred.values(ec);
+            }))(std::move(handler));
+    return;
+  }
+#endif
+  t->timer_.async_wait(std::move(handler));
 }
 
 void system_timer::try_wait_(void * this_, boost::cobalt::handler<error_code> h)
 {
-  if (static_cast<system_timer*>(this_)->timer_.expiry()
+  if (static_cast<system_timer*>(this_)->expiry()
       < std::chrono::system_clock::now())
     h({});
 }
@@ -0,0 +1,342 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <cobalt/io/timer_wheel.hpp>
+
+#include <boost/asio/append.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/throw_exception.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__linux__)
+#include <time.h>
+#endif
+
+namespace cobalt::io
+{
+
+net::execution_context::id timer_wheel::id;
+
+namespace
+{
+// use_service locks the context's registry, so the last lookup is kept per thread.
+// A context might get allocated where a destroyed one was, so the wheel's liveness is kept too.
+thread_local net::execution_context * last_context = nullptr;
+thread_local std::shared_ptr<const bool> last_alive;
+thread_local timer_wheel * last_wheel = nullptr;
+}
+
+timer_wheel::timer_wheel(net::execution_context & ctx) : net::execution_context::service(ctx)
+{
+  if (auto ioc = dynamic_cast<net::io_context*>(&ctx))
+    timer_.emplace(ioc->get_executor());
+}
+
+timer_wheel::~timer_wheel()
+{
+  *alive_ = false;
+}
+
+timer_wheel & timer_wheel::get(const executor & exec)
+{
+  auto & ctx = net::query(exec, net::execution::context);
+  if (last_context == &ctx && last_alive && *last_alive)
+    return *last_wheel;
+
+  auto & wheel = net::use_service<timer_wheel>(ctx);
+  if (!wheel.timer_)
+    wheel.timer_.emplace(exec);
+  last_context = &ctx;
+  last_alive = wheel.alive_;
+  last_wheel = &wheel;
+  return wheel;
+}
+
+executor timer_wheel::get_executor() const
+{
+  if (!timer_)
+    BOOST_THROW_EXCEPTION(std::logic_error("timer_wheel has no executor, it needs to be obtained through get"));
+  return timer_->get_executor();
+}
+
+bool timer_wheel::set_granularity(duration tick)
+{
+  if (size_ != 0u || tick <= duration::zero())
+    return false;
+  granularity_ = tick;
+  start_ = now();
+  current_ = 0u;
+  armed_.reset();
+  return true;
+}
+
+void timer_wheel::shutdown()
+{
+  for (auto & head : heads_)
+    while (auto e = head)
+    {
+      unlink_(*e);
+      e->wheel_ = nullptr;
+      e->callback_ = nullptr;
+      e->handler_.reset();
+    }
+  size_ = 0u;
+  timer_.reset();
+}
+
+// rounded up, so a timer never fires early.
+std::uint64_t timer_wheel::tick_of_(time_point tp) const
+{
+  if (tp <= start_)
+    return 0u;
+  const auto d = (tp - start_).count();
+  const auto g = granularity_.count();
+  return static_cast<std::uint64_t>((d + g - 1) / g);
+}
+
+auto timer_wheel::now() const -> time_point
+{
+#if defined(CLOCK_MONOTONIC_COARSE)
+  // steady_clock is CLOCK_MONOTONIC, which has the same epoch.
+  if (coarse_)
+  {
+    timespec ts;
+    if (::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0)
+      return time_point(std::chrono::duration_cast<duration>(
+          std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)));
+  }
+#endif
+  return clock_type::now();
+}
+
+// the last tick that has fully passed.
+std::uint64_t timer_wheel::now_tick_() const
+{
+  const auto n = now();
+  return n <= start_ ? 0u : static_cast<std::uint64_t>((n - start_) / granularity_);
+}
+
+void timer_wheel::link_(entry & e, std::uint32_t slot)
+{
+  e.slot_ = slot;
+  e.prev_ = nullptr;
+  e.next_ = heads_[slot];
+  if (e.next_)
+    e.next_->prev_ = &e;
+  heads_[slot] = &e;
+  if (slot != due_slot)
+    occupied_[slot / slots] |= std::uint64_t(1u) << (slot % slots);
+}
+
+void timer_wheel::unlink_(entry & e)
+{
+  if (e.prev_)
+    e.prev_->next_ = e.next_;
+  else
+    heads_[e.slot_] = e.next_;
+  if (e.next_)
+    e.next_->prev_ = e.prev_;
+
+  if (e.slot_ != due_slot && !heads_[e.slot_])
+    occupied_[e.slot_ / slots] &= ~(std::uint64_t(1u) << (e.slot_ % slots));
+  e.prev_ = e.next_ = nullptr;
+}
+
+// pick the lowest level whose revolution still covers the tick,
+// anything beyond the top level gets parked in its farthest slot & re-inserted when that cascades.
+void timer_wheel::insert_(entry & e, std::uint64_t tick)
+{
+  constexpr auto max_delta = (std::uint64_t(1u) << (slot_bits * levels)) - 1u;
+  BOOST_ASSERT(tick >= current_);
+  auto delta = tick - current_;
+  if (delta > max_delta)
+  {
+    delta = max_delta;
+    tick = current_ + max_delta;
+  }
+
+  std::uint32_t level = 0u;
+  while (level + 1u < levels && delta >= (std::uint64_t(1u) << (slot_bits * (level + 1u))))
+    level++;
+
+  link_(e, level * slots + static_cast<std::uint32_t>((tick >> (slot_bits * level)) & (slots - 1u)));
+}
+
+// the next tick at which a level-0 slot fires or a higher slot cascades.
+std::optional<std::uint64_t> timer_wheel::next_tick_() const
+{
+  std::optional<std::uint64_t> res;
+  for (std::uint32_t level = 0u; level < levels; level++)
+  {
+    const auto occ = occupied_[level];
+    if (occ == 0u)
+      continue;
+
+    const auto shift = slot_bits * level;
+    const auto pos = current_ >> shift;
+    const auto k = static_cast<std::uint64_t>(
+        std::countr_zero(std::rotr(occ, static_cast<int>((pos + 1u) & (slots - 1u)))));
+    const auto tick = (pos + 1u + k) << shift;
+    if (!res || tick < *res)
+      res = tick;
+  }
+  return res;
+}
+
+void timer_wheel::advance_(std::uint64_t target)
+{
+  while (current_ < target)
+  {
+    const auto next = next_tick_();
+    if (!next || *next > target)
+    {
+      current_ = target;
+      break;
+    }
+    current_ = *next;
+
+    for (auto level = levels - 1u; level > 0u; level--)
+    {
+      const auto shift = slot_bits * level;
+      if ((current_ & ((std::uint64_t(1u) << shift) - 1u)) != 0u)
+        continue;
+
+      const auto slot = level * slots + static_cast<std::uint32_t>((current_ >> shift) & (slots - 1u));
+      auto e = std::exchange(heads_[slot], nullptr);
+      occupied_[level] &= ~(std::uint64_t(1u) << (slot % slots));
+      while (e)
+      {
+        auto nx = e->next_;
+        insert_(*e, e->tick_);
+        e = nx;
+      }
+    }
+
+    // move them to the due list first, since a completion might insert or cancel.
+    const auto slot = static_cast<std::uint32_t>(current_ & (slots - 1u));
+    auto e = std::exchange(heads_[slot], nullptr);
+    occupied_[0u] &= ~(std::uint64_t(1u) << slot);
+    while (e)
+    {
+      auto nx = e->next_;
+      link_(*e, due_slot);
+      e = nx;
+    }
+
+    while (auto d = heads_[due_slot])
+      fire_(*d, {});
+  }
+}
+
+void timer_wheel::arm_()
+{
+  const auto next = next_tick_();
+  if (!next || (armed_ && *armed_ <= *next))
+    return;
+
+  BOOST_ASSERT(timer_);
+  armed_ = next;
+  // this aborts a later wait that's still pending.
+  timer_->expires_at(start_ + granularity_ * static_cast<duration::rep>(*next));
+  timer_->async_wait(
+      [this](error_code ec)
+      {
+        if (ec || !armed_)
+          return;
+        // a coarse clock might not have caught up with the one asio uses.
+        const auto target = std::max(*std::exchange(armed_, std::nullopt), now_tick_());
+        advance_(target);
+        arm_();
+      });
+}
+
+void timer_wheel::fire_(entry & e, error_code ec)
+{
+  unlink_(e);
+  size_--;
+  e.wheel_ = nullptr;
+  if (auto fn = std::exchange(e.callback_, nullptr))
+    return fn(e.arg_);
+
+  auto h = std::move(*e.handler_);
+  e.handler_.reset();
+  net::get_associated_cancellation_slot(h).clear();
+  std::move(h)(ec);
+}
+
+void timer_wheel::add_(entry & e, time_point expiry)
+{
+  BOOST_ASSERT(!e.pending());
+  if (size_ == 0u)
+    current_ = std::max(current_, now_tick_());
+
+  e.wheel_ = this;
+  e.tick_ = std::max(tick_of_(expiry), current_ + 1u);
+  insert_(e, e.tick_);
+  size_++;
+}
+
+void timer_wheel::async_wait(entry & e, time_point expiry, completion_handler<error_code> handler)
+{
+  if (!timer_)
+    timer_.emplace(net::get_associated_executor(handler));
+  add_(e, expiry);
+  e.handler_.emplace(std::move(handler));
+
+  auto slot = net::get_associated_cancellation_slot(*e.handler_);
+  if (slot.is_connected())
+    slot.assign(
+        [this, &e](net::cancellation_type ct)
+        {
+          if (ct != net::cancellation_type::none && e.wheel_ == this)
+          {
+            // we're inside the slot's handler, so it must not be cleared here.
+            unlink_(e);
+            size_--;
+            auto h = std::move(*e.handler_);
+            e.handler_.reset();
+            e.wheel_ = nullptr;
+            net::post(net::append(std::move(h), error_code{net::error::operation_aborted}));
+          }
+        });
+
+  arm_();
+}
+
+void timer_wheel::schedule(entry & e, time_point expiry, void (*fn)(void *), void * arg)
+{
+  add_(e, expiry);
+  e.callback_ = fn;
+  e.arg_ = arg;
+  arm_();
+}
+
+std::size_t timer_wheel::cancel(entry & e)
+{
+  if (e.wheel_ != this)
+    return 0u;
+
+  unlink_(e);
+  size_--;
+  e.wheel_ = nullptr;
+  if (std::exchange(e.callback_, nullptr))
+    return 1u;
+
+  auto h = std::move(*e.handler_);
+  e.handler_.reset();
+  net::get_associated_cancellation_slot(h).clear();
+  net::post(net::append(std::move(h), error_code{net::error::operation_aborted}));
+  return 1u;
+}
+
+}
@@ -0,0 +1,162 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <cobalt/io/write_queue.hpp>
+
+#include <boost/asio/append.hpp>
+#include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/cobalt/experimental/composition.hpp>
+#include <cobalt/io/write.hpp>
+
+namespace cobalt::io
+{
+
+void write_queue::close()
+{
+  closed_ = true;
+  wake_();
+}
+
+// posted, so the writer doesn't run in the middle of a producer's await_ready
+void write_queue::wake_()
+{
+  if (!writer_)
+    return;
+  auto h = std::move(*writer_);
+  writer_.reset();
+  net::get_associated_cancellation_slot(h).clear();
+  net::post(net::append(std::move(h), error_code{}, std::size_t{0u}));
+}
+
+void write_queue::push_(const_buffer_sequence buffers)
+{
+  for (const net::const_buffer & b : buffers)
+  {
+    auto p = static_cast<const unsigned char*>(b.data());
+    pending_.insert(pending_.end(), p, p + b.size());
+  }
+  wake_();
+}
+
+void write_queue::admit_()
+{
+  while (!waiting_.empty())
+  {
+    auto & [buffers, h] = waiting_.front();
+    const auto n = net::buffer_size(buffers);
+    if (!error_ && !fits_(n))
+      break;
+
+    net::get_associated_cancellation_slot(h).clear();
+    if (error_)
+      net::post(net::append(std::move(h), error_, std::size_t{0u}));
+    else
+    {
+      push_(buffers);
+      net::post(net::append(std::move(h), error_code{}, n));
+    }
+    waiting_.pop_front();
+  }
+}
+
+void write_queue::try_write_some_(void * this_, const_buffer_sequence buffers, boost::cobalt::handler<error_code, std::size_t> h)
+{
+  auto q = static_cast<write_queue*>(this_);
+  const auto n = net::buffer_size(buffers);
+  if (!q->error_ && !q->closed_ && q->waiting_.empty() && q->fits_(n))
+  {
+    q->push_(buffers);
+    h({}, n);
+  }
+}
+
+void write_queue::initiate_write_some_(void * this_, const_buffer_sequence buffers,
+                                       boost::cobalt::completion_handler<error_code, std::size_t> handler)
+{
+  auto q = static_cast<write_queue*>(this_);
+  if (q->error_)
+    return handler(q->error_, 0u);
+  if (q->closed_)
+    return handler(net::error::broken_pipe, 0u);
+
+  const auto n = net::buffer_size(buffers);
+  if (q->waiting_.empty() && q->fits_(n))
+  {
+    q->push_(buffers);
+    return handler({}, n);
+  }
+  // keep the order, so this waits even if a later, smaller message would fit.
+  auto itr = q->waiting_.emplace(q->waiting_.end(), buffers, std::move(handler));
+  auto slot = net::get_associated_cancellation_slot(itr->second);
+  if (slot.is_connected())
+    slot.assign(
+        [q, itr](net::cancellation_type ct)
+        {
+          if (ct == net::cancellation_type::none)
+            return;
+          // we're inside the slot's handler, so it must not be cleared here.
+          auto h = std::move(itr->second);
+          q->waiting_.erase(itr);
+          net::post(net::append(std::move(h), error_code{net::error::operation_aborted}, std::size_t{0u}));
+          // the head might have been what kept smaller messages waiting.
+          q->admit_();
+        });
+}
+
+void write_queue::initiate_wait_(void * this_, const_buffer_sequence,
+                                 boost::cobalt::completion_handler<error_code, std::size_t> handler)
+{
+  auto q = static_cast<write_queue*>(this_);
+  if (!q->pending_.empty() || q->closed_)
+    return handler({}, 0u);
+  q->writer_.emplace(std::move(handler));
+  auto slot = net::get_associated_cancellation_slot(*q->writer_);
+  if (slot.is_connected())
+    slot.assign(
+        [q](net::cancellation_type ct)
+        {
+          if (ct == net::cancellation_type::none || !q->writer_)
+            return;
+          auto h = std::move(*q->writer_);
+          q->writer_.reset();
+          net::post(net::append(std::move(h), error_code{net::error::operation_aborted}, std::size_t{0u}));
+        });
+}
+
+void write_queue::initiate_run_(void * this_, const_buffer_sequence,
+                                boost::cobalt::completion_handler<error_code, std::size_t>)
+{
+  auto q = static_cast<write_queue*>(this_);
+  std::size_t total = 0u;
+  while (!q->error_)
+  {
+    if (q->pending_.empty())
+    {
+      if (q->closed_)
+        break;
+      [[maybe_unused]] auto [ec, n] = co_await write_op{{}, q, &initiate_wait_};
+      if (ec)
+        co_return {ec, total};
+      continue;
+    }
+
+    // everything queued so far goes out in one write.
+    std::swap(q->pending_, q->in_flight_);
+    q->op_.buffer = net::buffer(q->in_flight_);
+    auto [ec, n] = co_await write_all(q->op_);
+    total += n;
+    q->in_flight_.clear();
+    if (ec)
+      q->error_ = ec;
+    q->admit_();
+  }
+
+  co_return {q->error_, total};
+}
+
+}
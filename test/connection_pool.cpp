@@ -0,0 +1,111 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "test.hpp"
+
+#include <boost/cobalt/as_tuple.hpp>
+#include <boost/cobalt/promise.hpp>
+
+#include <cobalt/io/acceptor.hpp>
+#include <cobalt/io/connection_pool.hpp>
+
+#include <optional>
+#include <string>
+
+BOOST_AUTO_TEST_SUITE(connection_pool_);
+
+using namespace cobalt::io;
+
+static boost::cobalt::promise<error_code> acquire_error(connection_pool & pool, std::string service)
+{
+  auto [ec, c] = co_await boost::cobalt::as_tuple(pool.acquire("127.0.0.1", service));
+  co_return ec;
+}
+
+CO_TEST_CASE(reuse)
+{
+  acceptor acc{endpoint{tcp_v4, "127.0.0.1", 0u}};
+  const auto service = std::to_string(get<tcp_v4>(acc.local_endpoint()).port());
+  connection_pool pool;
+
+  stream_socket srv;
+  int fd;
+  {
+    auto c = co_await pool.acquire("127.0.0.1", service);
+    BOOST_REQUIRE(c);
+    BOOST_CHECK(c.tcp() != nullptr);
+    BOOST_CHECK(pool.size() == 1u);
+    BOOST_CHECK(pool.idle() == 0u);
+    fd = c.socket().native_handle();
+    co_await acc.accept(srv);
+  }
+  BOOST_CHECK(pool.size() == 1u);
+  BOOST_CHECK(pool.idle() == 1u);
+
+  {
+    auto c = co_await pool.acquire("127.0.0.1", service);
+    BOOST_CHECK(c.socket().native_handle() == fd);
+    BOOST_CHECK(pool.idle() == 0u);
+    c.discard();
+  }
+  BOOST_CHECK(pool.size() == 0u);
+  BOOST_CHECK(pool.idle() == 0u);
+}
+
+CO_TEST_CASE(wait_for_release)
+{
+  acceptor acc{endpoint{tcp_v4, "127.0.0.1", 0u}};
+  const auto service = std::to_string(get<tcp_v4>(acc.local_endpoint()).port());
+  connection_pool pool{1u};
+
+  auto c = co_await pool.acquire("127.0.0.1", service);
+  auto [ec, _] = co_await boost::cobalt::as_tuple(pool.acquire("127.0.0.1", service, nullptr, std::chrono::milliseconds(10)));
+  BOOST_CHECK(ec == boost::asio::error::timed_out);
+
+  auto waiting = acquire_error(pool, service);
+  BOOST_CHECK(!waiting.ready());
+  c = {};
+  BOOST_CHECK(co_await waiting == error_code{});
+  BOOST_CHECK(pool.size() == 1u);
+}
+
+CO_TEST_CASE(cancel_waiting)
+{
+  acceptor acc{endpoint{tcp_v4, "127.0.0.1", 0u}};
+  const auto service = std::to_string(get<tcp_v4>(acc.local_endpoint()).port());
+  connection_pool pool{1u};
+
+  auto c = co_await pool.acquire("127.0.0.1", service);
+  auto waiting = acquire_error(pool, service);
+  BOOST_CHECK(!waiting.ready());
+  waiting.cancel();
+  BOOST_CHECK(co_await waiting == boost::asio::error::operation_aborted);
+
+  // the cancelled waiter is gone, so the release goes to the next one.
+  auto next = acquire_error(pool, service);
+  c = {};
+  BOOST_CHECK(co_await next == error_code{});
+  BOOST_CHECK(pool.size() == 1u);
+}
+
+CO_TEST_CASE(destroy_while_waiting)
+{
+  acceptor acc{endpoint{tcp_v4, "127.0.0.1", 0u}};
+  const auto service = std::to_string(get<tcp_v4>(acc.local_endpoint()).port());
+  std::optional<connection_pool> pool{std::in_place, 1u};
+
+  auto c = co_await pool->acquire("127.0.0.1", service);
+  auto waiting = acquire_error(*pool, service);
+  BOOST_CHECK(!waiting.ready());
+
+  pool.reset();
+  BOOST_CHECK(co_await waiting == boost::asio::error::operation_aborted);
+  // outlived the pool, so it just gets closed.
+  c = {};
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -6,8 +6,11 @@
 //
 
 #include <cobalt/io/endpoint.hpp>
+#include <cobalt/io/endpoint_map.hpp>
 #include "test.hpp"
 
+#include <net/if.h>
+
 
 BOOST_AUTO_TEST_SUITE(endpoint_);
 
@@ -180,4 +183,138 @@ BOOST_AUTO_TEST_CASE(ip_)
   BOOST_CHECK(get<tcp>(ep).addr_str() == "2001:db8:1::ab9:c0a8:102");
 }
 
+BOOST_AUTO_TEST_CASE(literal_)
+{
+  using namespace cobalt::io::literals;
+  static_assert(("[::1]:443"_ep).port == 443);
+
+  endpoint ep = "[::1]:443"_ep;
+  BOOST_CHECK(ep.protocol() == ip_v6);
+  BOOST_CHECK(get<tcp>(ep).port() == 443);
+  BOOST_CHECK(get<tcp>(ep).addr_str() == "::1");
+
+  ep = endpoint{ip, "127.0.0.1:80"};
+  BOOST_CHECK(ep.protocol() == ip_v4);
+  BOOST_CHECK(get<tcp>(ep).port() == 80);
+  BOOST_CHECK(get<tcp>(ep).addr_str() == "127.0.0.1");
+
+  ep = endpoint{ip, "::ffff:10.0.0.1", 80};
+  BOOST_CHECK(get<tcp>(ep).addr_str() == "::ffff:10.0.0.1");
+  BOOST_CHECK_THROW((endpoint{ip_v4, "10.0.0.256", 80}), boost::system::system_error);
+}
+
+BOOST_AUTO_TEST_CASE(scope_)
+{
+  auto scope_of = [](const endpoint & ep)
+  {
+    return static_cast<const boost::asio::detail::sockaddr_in6_type*>(ep.data())->sin6_scope_id;
+  };
+
+  endpoint ep{ip, "[fe80::1%2]:80"};
+  BOOST_CHECK(ep.protocol() == ip_v6);
+  BOOST_CHECK(get<tcp>(ep).port() == 80);
+  BOOST_CHECK(get<tcp>(ep).addr_str() == "fe80::1");
+  BOOST_CHECK(scope_of(ep) == 2u);
+
+  ep = endpoint{ip_v6, "fe80::1%lo", 80};
+  BOOST_CHECK(scope_of(ep) == ::if_nametoindex("lo"));
+  BOOST_CHECK(ep != (endpoint{ip_v6, "fe80::1", 80}));
+
+  ep = endpoint{ip, "fe80::1%3", 443};
+  BOOST_CHECK(scope_of(ep) == 3u);
+
+  BOOST_CHECK_THROW((endpoint{ip_v6, "fe80::1%", 80}), boost::system::system_error);
+  BOOST_CHECK_THROW((endpoint{ip_v6, "fe80::1%no-such-interface", 80}), boost::system::system_error);
+}
+
+BOOST_AUTO_TEST_CASE(hash_)
+{
+  const endpoint a{ip_v4, "10.0.0.1", 80}, b{tcp_v4, "10.0.0.1", 80}, c{ip_v4, "10.0.0.1", 81};
+  BOOST_CHECK(a == b);
+  BOOST_CHECK(!(a == c));
+  BOOST_CHECK(std::hash<endpoint>{}(a) == std::hash<endpoint>{}(b));
+
+  endpoint_map<int> m;
+  m[a] = 1;
+  m[c] = 2;
+  m[endpoint{ip_v6, "::1", 80}] = 3;
+  BOOST_CHECK(m.size() == 3u);
+  BOOST_CHECK(m.find(b)->second == 1);
+  BOOST_CHECK(m.erase(a) == 1u);
+  BOOST_CHECK(!m.contains(b));
+  BOOST_CHECK(m.find(c)->second == 2);
+}
+
+#if !defined(BOOST_COBALT_NO_PMR)
+
+namespace
+{
+
+struct counting_resource final : boost::cobalt::pmr::memory_resource
+{
+  std::size_t allocations = 0u;
+
+  void * do_allocate(std::size_t bytes, std::size_t align) override
+  {
+    allocations++;
+    return boost::cobalt::pmr::new_delete_resource()->allocate(bytes, align);
+  }
+  void do_deallocate(void * p, std::size_t bytes, std::size_t align) override
+  {
+    boost::cobalt::pmr::new_delete_resource()->deallocate(p, bytes, align);
+  }
+  bool do_is_equal(const memory_resource & other) const noexcept override {return this == &other;}
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(sequence_)
+{
+  counting_resource res;
+  endpoint_sequence seq{&res};
+  for (std::uint16_t i = 0u; i < 4u; i++)
+    seq.emplace_back(ip_v4, "10.0.0.1", 80 + i);
+  BOOST_CHECK(res.allocations == 0u);
+
+  // the fifth one spills to the allocator.
+  seq.emplace_back(ip_v6, "fe80::1%3", 84);
+  BOOST_CHECK(res.allocations == 1u);
+  BOOST_REQUIRE(seq.size() == 5u);
+
+  auto check = [](const endpoint_sequence & s)
+  {
+    BOOST_REQUIRE(s.size() == 5u);
+    for (std::uint16_t i = 0u; i < 4u; i++)
+    {
+      BOOST_CHECK(s[i].size() == sizeof(boost::asio::detail::sockaddr_in4_type));
+      BOOST_CHECK(get<ip_v4>(s[i]).port() == 80 + i);
+      BOOST_CHECK(get<ip_v4>(s[i]).addr_str() == "10.0.0.1");
+    }
+    BOOST_CHECK(s[4].size() == sizeof(boost::asio::detail::sockaddr_in6_type));
+    BOOST_CHECK(get<ip_v6>(s[4]).port() == 84);
+    BOOST_CHECK(static_cast<const boost::asio::detail::sockaddr_in6_type*>(s[4].data())->sin6_scope_id == 3u);
+  };
+
+  const endpoint_sequence copied{seq, &res};
+  check(copied);
+  BOOST_CHECK(res.allocations == 2u);
+
+  const auto moved = std::move(seq);
+  check(moved);
+  BOOST_CHECK(res.allocations == 2u);
+
+  // back to inline storage, copies of the shorter endpoints don't carry stale bytes.
+  endpoint_sequence small{&res};
+  small.assign(copied.begin(), copied.begin() + 2);
+  small.push_back(copied[4]);
+  small[0] = copied[4];
+  BOOST_CHECK(small[0] == copied[4]);
+  small[0] = copied[1];
+  BOOST_CHECK(small[0] == copied[1]);
+  BOOST_CHECK(std::hash<endpoint>{}(small[0]) == std::hash<endpoint>{}(copied[1]));
+  BOOST_CHECK(res.allocations == 2u);
+}
+
+#endif
+
 BOOST_AUTO_TEST_SUITE_END();
\ No newline at end of file
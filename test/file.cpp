@@ -0,0 +1,471 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "test.hpp"
+
+#include <boost/cobalt/as_tuple.hpp>
+#include <boost/cobalt/op.hpp>
+
+#include <cobalt/io/blocking_pool.hpp>
+#include <cobalt/io/mapped_file.hpp>
+#include <cobalt/io/random_access_file.hpp>
+#include <cobalt/io/read.hpp>
+#include <cobalt/io/stream_file.hpp>
+#include <cobalt/io/write.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace cobalt::io;
+
+namespace
+{
+
+// a file in the temp directory that gets removed again at the end of the test.
+struct temp_path
+{
+  std::string path;
+
+  temp_path()
+  {
+    static std::atomic<unsigned> cnt{0u};
+    path = (std::filesystem::temp_directory_path() /
+            ("cobalt-io-test-" + std::to_string(::getpid()) + "-" + std::to_string(cnt++))).string();
+  }
+  ~temp_path()
+  {
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+  }
+};
+
+const auto rw_create = file::read_write | file::create | file::truncate;
+
+std::string_view as_string(const_buffer buf)
+{
+  return {static_cast<const char*>(buf.data()), buf.size()};
+}
+
+struct read_at final : boost::cobalt::op<error_code, std::size_t>
+{
+  int fd;
+  std::uint64_t offset;
+  mutable_buffer buf;
+  read_at(int fd, std::uint64_t offset, mutable_buffer buf) : fd(fd), offset(offset), buf(buf) {}
+
+  void initiate(boost::cobalt::completion_handler<error_code, std::size_t> h) final
+  {
+    blocking_read_some_at(fd, offset, buf, std::move(h));
+  }
+};
+
+struct write_at final : boost::cobalt::op<error_code, std::size_t>
+{
+  int fd;
+  std::uint64_t offset;
+  const_buffer buf;
+  write_at(int fd, std::uint64_t offset, const_buffer buf) : fd(fd), offset(offset), buf(buf) {}
+
+  void initiate(boost::cobalt::completion_handler<error_code, std::size_t> h) final
+  {
+    blocking_write_some_at(fd, offset, buf, std::move(h));
+  }
+};
+
+struct on_pool final : boost::cobalt::op<std::thread::id>
+{
+  void initiate(boost::cobalt::completion_handler<std::thread::id> h) final
+  {
+    blocking_pool::get().post([]{return std::make_tuple(std::this_thread::get_id());}, std::move(h));
+  }
+};
+
+}
+
+BOOST_AUTO_TEST_SUITE(blocking_pool_);
+
+CO_TEST_CASE(post)
+{
+  BOOST_CHECK(co_await on_pool{} != std::this_thread::get_id());
+}
+
+CO_TEST_CASE(read_write_at)
+{
+  temp_path tmp;
+  stream_file f{tmp.path, rw_create};
+
+  BOOST_CHECK(co_await write_at(f.native_handle(), 4u, buffer("data", 4u)) == 4u);
+  char buf[8];
+  BOOST_CHECK(co_await read_at(f.native_handle(), 0u, buffer(buf)) == 8u);
+  BOOST_CHECK(std::string_view(buf + 4, 4u) == "data");
+
+  auto [ec, n] = co_await boost::cobalt::as_tuple(read_at(f.native_handle(), 8u, buffer(buf)));
+  BOOST_CHECK(ec == boost::asio::error::eof);
+  BOOST_CHECK(n == 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+BOOST_AUTO_TEST_SUITE(mapped_file_);
+
+CO_TEST_CASE(map)
+{
+  temp_path tmp;
+  stream_file f{tmp.path, rw_create};
+  const auto content = std::string(5000u, 'x') + "tail";
+  co_await write(f, buffer(content.data(), content.size()));
+
+  mapped_file m{f};
+  BOOST_REQUIRE(m.is_mapped());
+  BOOST_CHECK(m.size() == content.size());
+  BOOST_CHECK(as_string(m.view()) == content);
+
+  // not page aligned & longer than the file, so it gets clamped to its end.
+  m.map(f, 4998u, 4096u).value();
+  BOOST_CHECK(m.size() == 6u);
+  BOOST_CHECK(as_string(m.view()) == "xxtail");
+  BOOST_CHECK(as_string(m.view(2u, 2u)) == "ta");
+  BOOST_CHECK(as_string(m.view(4u, mapped_file::npos)) == "il");
+  BOOST_CHECK(m.view(100u).size() == 0u);
+
+  BOOST_CHECK(!m.map(f, content.size() + 1u));
+  BOOST_CHECK(!m.is_mapped());
+
+  m.map(f, content.size()).value();
+  BOOST_CHECK(!m.is_mapped());
+}
+
+CO_TEST_CASE(writable)
+{
+  temp_path tmp;
+  stream_file f{tmp.path, rw_create};
+  co_await write(f, buffer("hello", 5u));
+
+  mapped_file m{f, 0u, mapped_file::npos, true};
+  auto v = m.mutable_view(0u, 1u);
+  *static_cast<char*>(v.data()) = 'j';
+  m.flush().value();
+
+  char buf[5];
+  BOOST_CHECK(co_await read_at(f.native_handle(), 0u, buffer(buf)) == 5u);
+  BOOST_CHECK(std::string_view(buf, 5u) == "jello");
+}
+
+CO_TEST_CASE(advise)
+{
+  temp_path tmp;
+  stream_file f{tmp.path, rw_create};
+  const std::string content(3u * 4096u, 'a');
+  co_await write(f, buffer(content.data(), content.size()));
+
+  mapped_file m{f, 100u};
+  for (auto adv : {mapped_file::normal, mapped_file::sequential, mapped_file::random,
+                   mapped_file::will_need, mapped_file::dont_need})
+  {
+    BOOST_CHECK(m.advise(adv));
+    BOOST_CHECK(m.advise(adv, 5000u, 10u));
+  }
+  BOOST_CHECK(as_string(m.view()) == std::string_view(content).substr(100u));
+}
+
+CO_TEST_CASE(prefetch)
+{
+  temp_path tmp;
+  stream_file f{tmp.path, rw_create};
+  const std::string content(4u * 4096u, 'p');
+  co_await write(f, buffer(content.data(), content.size()));
+
+  mapped_file m{f, 10u};
+  co_await m.prefetch();
+  co_await m.prefetch(5000u, 100u);
+  BOOST_CHECK(as_string(m.view()) == std::string_view(content).substr(10u));
+
+  // the pages are gone now, which must not fault.
+  f.resize(0u).value();
+  co_await m.prefetch();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+BOOST_AUTO_TEST_SUITE(random_access_file_);
+
+CO_TEST_CASE(round_trip)
+{
+  temp_path tmp;
+  random_access_file f{tmp.path, rw_create};
+
+  BOOST_CHECK(co_await f.write_some_at(6u, buffer("world", 5u)) == 5u);
+  BOOST_CHECK(co_await f.write_some_at(0u, buffer("hello ", 6u)) == 6u);
+  BOOST_CHECK(f.size().value() == 11u);
+
+  char buf[11];
+  BOOST_CHECK(co_await f.read_some_at(0u, buffer(buf)) == 11u);
+  BOOST_CHECK(std::string_view(buf, 11u) == "hello world");
+  BOOST_CHECK(co_await f.read_some_at(6u, buffer(buf)) == 5u);
+  BOOST_CHECK(std::string_view(buf, 5u) == "world");
+
+  auto [ec, n] = co_await boost::cobalt::as_tuple(f.read_some_at(11u, buffer(buf)));
+  BOOST_CHECK(ec == boost::asio::error::eof);
+  BOOST_CHECK(n == 0u);
+
+  f.resize(5u).value();
+  BOOST_CHECK(f.size().value() == 5u);
+  BOOST_CHECK(co_await f.read_some_at(0u, buffer(buf)) == 5u);
+  BOOST_CHECK(std::string_view(buf, 5u) == "hello");
+}
+
+CO_TEST_CASE(direct_io)
+{
+  temp_path tmp;
+  random_access_file f{tmp.path, rw_create};
+  if (!f.set_direct_io(true))
+  {
+    BOOST_TEST_MESSAGE("O_DIRECT isn't supported by " << tmp.path << ", skipping");
+    co_return;
+  }
+  BOOST_CHECK(f.direct_io());
+
+  const auto align = f.offset_alignment();
+  std::vector<std::byte, aligned_allocator<std::byte>> data(2u * align, f.get_aligned_allocator());
+  for (std::size_t i = 0u; i < data.size(); i++)
+    data[i] = static_cast<std::byte>(i % 251u);
+
+  // e.g. tmpfs on older kernels accepts the flag, but not the I/O.
+  auto [ec, n] = co_await boost::cobalt::as_tuple(f.write_some_at(0u, buffer(data.data(), data.size())));
+  if (ec == boost::asio::error::invalid_argument)
+  {
+    BOOST_TEST_MESSAGE("O_DIRECT isn't supported by " << tmp.path << ", skipping");
+    co_return;
+  }
+  BOOST_REQUIRE(!ec);
+  BOOST_CHECK(n == data.size());
+
+  std::vector<std::byte, aligned_allocator<std::byte>> in(data.size(), f.get_aligned_allocator());
+  BOOST_CHECK(co_await f.read_some_at(0u, buffer(in.data(), in.size())) == in.size());
+  BOOST_CHECK(in == data);
+
+  // offset, size & memory are unaligned, so it reads through a bounce buffer.
+  std::vector<std::byte> part(101u);
+  BOOST_CHECK(co_await f.read_some_at(align - 50u, buffer(part.data() + 1, 100u)) == 100u);
+  BOOST_CHECK(std::equal(part.begin() + 1, part.end(), data.begin() + (align - 50u)));
+
+  // only the memory is unaligned, so the write gets copied into an aligned buffer.
+  std::vector<std::byte> unaligned(align + 1u, std::byte{7});
+  BOOST_CHECK(co_await f.write_some_at(align, buffer(unaligned.data() + 1, align)) == align);
+  BOOST_CHECK(co_await f.read_some_at(align, buffer(in.data(), align)) == align);
+  BOOST_CHECK(std::all_of(in.begin(), in.begin() + align, [](std::byte b) {return b == std::byte{7};}));
+}
+
+CO_TEST_CASE(direct_io_unaligned_write)
+{
+  temp_path tmp;
+  random_access_file f{tmp.path, rw_create};
+  if (!f.set_direct_io(true))
+  {
+    BOOST_TEST_MESSAGE("O_DIRECT isn't supported by " << tmp.path << ", skipping");
+    co_return;
+  }
+
+  // writing a partial block would need a read first, so it's rejected instead.
+  std::vector<std::byte, aligned_allocator<std::byte>> data(f.offset_alignment(), f.get_aligned_allocator());
+  auto [ec, n] = co_await boost::cobalt::as_tuple(f.write_some_at(1u, buffer(data.data(), data.size())));
+  BOOST_CHECK(ec == boost::asio::error::invalid_argument);
+  BOOST_CHECK(n == 0u);
+
+  std::tie(ec, n) = co_await boost::cobalt::as_tuple(f.write_some_at(0u, buffer(data.data(), data.size() - 1u)));
+  BOOST_CHECK(ec == boost::asio::error::invalid_argument);
+  BOOST_CHECK(n == 0u);
+}
+
+CO_TEST_CASE(read_many)
+{
+  temp_path tmp;
+  random_access_file f{tmp.path, rw_create};
+  co_await f.write_some_at(0u, buffer("0123456789", 10u));
+
+  char a[3], b[4], c[2];
+  random_access_file::range ranges[] = {{7u, buffer(a)}, {0u, buffer(b)}, {4u, buffer(c)}};
+  BOOST_CHECK(co_await f.read_many(ranges) == 9u);
+  BOOST_CHECK(std::string_view(a, 3u) == "789");
+  BOOST_CHECK(std::string_view(b, 4u) == "0123");
+  BOOST_CHECK(std::string_view(c, 2u) == "45");
+
+  // the last range is cut short by the end of the file.
+  random_access_file::range short_read[] = {{8u, buffer(a)}};
+  BOOST_CHECK(co_await f.read_many(short_read) == 2u);
+  BOOST_CHECK(short_read[0].second.size() == 2u);
+
+  // the range past the end fails, which gets reported & cancels the rest.
+  random_access_file::range failing[] = {{0u, buffer(b)}, {20u, buffer(c)}};
+  auto [ec, n] = co_await boost::cobalt::as_tuple(f.read_many(failing));
+  BOOST_CHECK(ec == boost::asio::error::eof);
+  BOOST_CHECK(n <= 4u);
+  BOOST_CHECK(failing[1].second.size() == 0u);
+}
+
+CO_TEST_CASE(read_stream)
+{
+  temp_path tmp;
+  random_access_file f{tmp.path, rw_create};
+  co_await f.write_some_at(0u, buffer("abcdefgh", 8u));
+
+  char a[4], b[4], c[4];
+  random_access_file::range ranges[] = {{0u, buffer(a)}, {4u, buffer(b)}, {16u, buffer(c)}};
+  random_access_file::read_stream rs{f, ranges};
+  BOOST_CHECK(rs.pending() == 3u);
+
+  bool seen[3] = {};
+  std::size_t total = 0u;
+  while (rs.pending() > 0u)
+  {
+    auto [ec, idx, n] = co_await boost::cobalt::as_tuple(rs.next());
+    BOOST_REQUIRE(idx < 3u);
+    BOOST_CHECK(!seen[idx]);
+    seen[idx] = true;
+    BOOST_CHECK(ec == (idx == 2u ? error_code{boost::asio::error::eof} : error_code{}));
+    BOOST_CHECK(n == ranges[idx].second.size());
+    total += n;
+  }
+  BOOST_CHECK(total == 8u);
+  BOOST_CHECK(std::string_view(a, 4u) == "abcd");
+  BOOST_CHECK(std::string_view(b, 4u) == "efgh");
+
+  auto [ec, idx, n] = co_await boost::cobalt::as_tuple(rs.next());
+  BOOST_CHECK(ec == boost::asio::error::not_found);
+}
+
+CO_TEST_CASE(read_many_direct_io)
+{
+  temp_path tmp;
+  random_access_file f{tmp.path, rw_create};
+  std::string content(8192u, '\0');
+  for (std::size_t i = 0u; i < content.size(); i++)
+    content[i] = static_cast<char>('a' + i % 26u);
+  BOOST_REQUIRE(co_await f.write_some_at(0u, buffer(content.data(), content.size())) == content.size());
+
+  if (!f.set_direct_io(true))
+  {
+    BOOST_TEST_MESSAGE("O_DIRECT isn't supported by " << tmp.path << ", skipping");
+    co_return;
+  }
+
+  // unaligned, so they go through bounce buffers.
+  char a[10], b[100];
+  random_access_file::range ranges[] = {{3u, buffer(a)}, {4000u, buffer(b)}};
+  auto [ec, n] = co_await boost::cobalt::as_tuple(f.read_many(ranges));
+  if (ec == boost::asio::error::invalid_argument)
+  {
+    BOOST_TEST_MESSAGE("O_DIRECT isn't supported by " << tmp.path << ", skipping");
+    co_return;
+  }
+  BOOST_CHECK(!ec);
+  BOOST_CHECK(n == 110u);
+  BOOST_CHECK(std::string_view(a, 10u) == std::string_view(content).substr(3u, 10u));
+  BOOST_CHECK(std::string_view(b, 100u) == std::string_view(content).substr(4000u, 100u));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+BOOST_AUTO_TEST_SUITE(stream_file_);
+
+CO_TEST_CASE(round_trip)
+{
+  temp_path tmp;
+  stream_file f{tmp.path, rw_create};
+
+  BOOST_CHECK(co_await write(f, buffer("hello world", 11u)) == 11u);
+  BOOST_CHECK(f.seek(0, file::seek_set).value() == 0u);
+
+  char buf[11];
+  BOOST_CHECK(co_await read(f, buffer(buf)) == 11u);
+  BOOST_CHECK(std::string_view(buf, 11u) == "hello world");
+
+  auto [ec, n] = co_await boost::cobalt::as_tuple(f.read_some(buffer(buf)));
+  BOOST_CHECK(ec == boost::asio::error::eof);
+  BOOST_CHECK(n == 0u);
+}
+
+CO_TEST_CASE(seek)
+{
+  temp_path tmp;
+  stream_file f{tmp.path, rw_create};
+  co_await write(f, buffer("0123456789", 10u));
+
+  BOOST_CHECK(f.seek(3, file::seek_set).value() == 3u);
+  BOOST_CHECK(f.seek(2, file::seek_cur).value() == 5u);
+  char c;
+  BOOST_CHECK(co_await read(f, buffer(&c, 1u)) == 1u);
+  BOOST_CHECK(c == '5');
+
+  BOOST_CHECK(f.seek(-1, file::seek_end).value() == 9u);
+  BOOST_CHECK(co_await read(f, buffer(&c, 1u)) == 1u);
+  BOOST_CHECK(c == '9');
+
+  BOOST_CHECK(!f.seek(-11, file::seek_end));
+}
+
+CO_TEST_CASE(resize)
+{
+  temp_path tmp;
+  stream_file f{tmp.path, rw_create};
+  co_await write(f, buffer("0123456789", 10u));
+
+  BOOST_CHECK(f.resize(4u));
+  BOOST_CHECK(f.size().value() == 4u);
+  BOOST_CHECK(f.seek(0, file::seek_end).value() == 4u);
+
+  // growing fills with zeros.
+  BOOST_CHECK(f.resize(6u));
+  BOOST_CHECK(f.seek(0, file::seek_set).value() == 0u);
+  char buf[6];
+  BOOST_CHECK(co_await read(f, buffer(buf)) == 6u);
+  BOOST_CHECK(std::string_view(buf, 6u) == std::string_view("0123\0\0", 6u));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+BOOST_AUTO_TEST_SUITE(file_);
+
+CO_TEST_CASE(async_sync)
+{
+  temp_path tmp;
+  stream_file f{tmp.path, rw_create};
+  co_await write(f, buffer("data", 4u));
+
+  co_await f.async_sync_data();
+  co_await f.async_sync_all();
+
+  f.close().value();
+  auto [ec] = co_await boost::cobalt::as_tuple(f.async_sync_all());
+  BOOST_CHECK(ec == boost::system::errc::bad_file_descriptor);
+}
+
+CO_TEST_CASE(sync_range)
+{
+  temp_path tmp;
+  stream_file f{tmp.path, rw_create};
+  const std::string content(8192u, 's');
+  co_await write(f, buffer(content.data(), content.size()));
+
+  auto r = f.sync_range(0u, 4096u);
+  if (r.has_error() && r.error() == boost::asio::error::operation_not_supported)
+  {
+    BOOST_TEST_MESSAGE("sync_file_range isn't supported, skipping");
+    co_return;
+  }
+  BOOST_CHECK(r);
+  BOOST_CHECK(f.sync_range(4096u, 0u, file::sync_wait_before | file::sync_write | file::sync_wait_after));
+  BOOST_CHECK(f.sync_range(0u, 0u, file::sync_wait_after));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -6,8 +6,16 @@
 //
 
 #include "test.hpp"
+#include <cobalt/io/dns_resolver.hpp>
 #include <cobalt/io/resolver.hpp>
 #include <boost/asio.hpp>
+#include <boost/cobalt/as_tuple.hpp>
+#include <boost/cobalt/op.hpp>
+#include <boost/cobalt/promise.hpp>
+
+#include <optional>
+#include <span>
+#include <vector>
 
 CO_TEST_CASE(resolver_)
 {
@@ -20,3 +28,212 @@ CO_TEST_CASE(resolver_)
 
 
 }
+
+CO_TEST_CASE(caching_resolver_)
+{
+  cobalt::io::caching_resolver res;
+
+  auto first  = co_await res.resolve("localhost", "80");
+  BOOST_REQUIRE(first.size() > 0u);
+  BOOST_CHECK(res.size() == 1u);
+
+  auto second = co_await res.resolve("localhost", "80");
+  BOOST_CHECK(std::equal(first.begin(), first.end(), second.begin(), second.end(),
+                         [](auto & l, auto & r) {return l.size() == r.size() && l.protocol() == r.protocol();}));
+  BOOST_CHECK(res.size() == 1u);
+}
+
+static boost::cobalt::promise<boost::system::error_code> resolve_error(cobalt::io::caching_resolver & res)
+{
+  auto [ec, eps] = co_await boost::cobalt::as_tuple(res.resolve("localhost", "80"));
+  co_return ec;
+}
+
+CO_TEST_CASE(caching_resolver_cancel)
+{
+  cobalt::io::caching_resolver res;
+
+  // both share one lookup, cancelling one doesn't affect the other.
+  auto cancelled = resolve_error(res);
+  auto other     = resolve_error(res);
+  cancelled.cancel();
+  BOOST_CHECK(co_await cancelled == boost::asio::error::operation_aborted);
+  BOOST_CHECK(co_await other == boost::system::error_code{});
+  BOOST_CHECK(res.size() == 1u);
+}
+
+CO_TEST_CASE(dns_resolver_numeric)
+{
+  cobalt::io::dns_resolver res;
+
+  auto eps = co_await res.resolve("[::1]", "443");
+  BOOST_REQUIRE(eps.size() == 1u);
+  BOOST_CHECK(eps.front().protocol() == cobalt::io::ip_v6);
+  BOOST_CHECK(get<cobalt::io::ip_v6>(eps.front()).port() == 443u);
+
+  // service names would need a blocking lookup.
+  auto [ec, named] = co_await boost::cobalt::as_tuple(res.resolve("[::1]", "https"));
+  BOOST_CHECK(ec == boost::asio::error::service_not_found);
+}
+
+namespace
+{
+
+// answers a.test (A & AAAA), tc.test (truncated over UDP, A over TCP) & nx.test (NXDOMAIN),
+// drops the first query for slow.test & never answers dead.test.
+struct stub_nameserver
+{
+  boost::asio::ip::udp::socket udp{boost::cobalt::this_thread::get_executor(),
+                                   {boost::asio::ip::make_address("127.0.0.1"), 0u}};
+  boost::asio::ip::tcp::acceptor tcp{boost::cobalt::this_thread::get_executor(),
+                                     {boost::asio::ip::make_address("127.0.0.1"), udp.local_endpoint().port()}};
+  std::size_t dropped = 0u;
+
+  cobalt::io::endpoint endpoint() const
+  {
+    return cobalt::io::endpoint{cobalt::io::ip_v4, "127.0.0.1", udp.local_endpoint().port()};
+  }
+
+  std::optional<std::vector<unsigned char>> respond(std::span<const unsigned char> query, bool over_tcp)
+  {
+    std::string name;
+    std::size_t p = 12u;
+    while (p < query.size() && query[p] != 0u)
+    {
+      if (!name.empty())
+        name += '.';
+      name.append(reinterpret_cast<const char*>(query.data() + p + 1u), query[p]);
+      p += query[p] + 1u;
+    }
+    const auto qend = p + 5u; // the terminating zero, type & class.
+    const std::uint16_t qtype = query[p + 1u] << 8 | query[p + 2u];
+
+    if (name == "dead.test")
+      return std::nullopt;
+    if (name == "slow.test" && dropped < 2u)
+    {
+      dropped++;
+      return std::nullopt;
+    }
+
+    std::vector<unsigned char> res(query.begin(), query.begin() + qend);
+    res[2] = 0x81u; // response, recursion desired
+    res[3] = 0x80u; // recursion available
+    res[6] = res[7] = 0u;
+
+    auto add = [&](std::initializer_list<unsigned char> rdata)
+    {
+      res[7]++;
+      res.insert(res.end(), {0xC0u, 0x0Cu, static_cast<unsigned char>(qtype >> 8), static_cast<unsigned char>(qtype),
+                             0u, 1u, 0u, 0u, 0u, 60u, 0u, static_cast<unsigned char>(rdata.size())});
+      res.insert(res.end(), rdata);
+    };
+
+    if (name == "nx.test")
+      res[3] |= 3u;
+    else if (name == "tc.test" && !over_tcp)
+      res[2] |= 0x02u;
+    else if (qtype == 1u)
+      add({127u, 0u, 0u, static_cast<unsigned char>(name == "tc.test" ? 3u : 2u)});
+    else if (qtype == 28u && name != "tc.test")
+      add({0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 2u});
+    return res;
+  }
+
+  boost::cobalt::promise<void> serve_udp()
+  {
+    std::array<unsigned char, 512u> buf;
+    boost::asio::ip::udp::endpoint sender;
+    while (true)
+    {
+      auto [ec, n] = co_await udp.async_receive_from(boost::asio::buffer(buf), sender,
+                                                     boost::asio::as_tuple(boost::cobalt::use_op));
+      if (ec)
+        co_return;
+      if (auto r = respond({buf.data(), n}, false))
+        co_await udp.async_send_to(boost::asio::buffer(*r), sender, boost::asio::as_tuple(boost::cobalt::use_op));
+    }
+  }
+
+  boost::cobalt::promise<void> serve_tcp()
+  {
+    while (true)
+    {
+      boost::asio::ip::tcp::socket s{boost::cobalt::this_thread::get_executor()};
+      auto [ec] = co_await tcp.async_accept(s, boost::asio::as_tuple(boost::cobalt::use_op));
+      if (ec)
+        co_return;
+
+      std::array<unsigned char, 2u> len;
+      std::tie(ec, std::ignore) = co_await boost::asio::async_read(s, boost::asio::buffer(len),
+                                                                   boost::asio::as_tuple(boost::cobalt::use_op));
+      std::vector<unsigned char> query(len[0] << 8 | len[1]);
+      if (!ec)
+        std::tie(ec, std::ignore) = co_await boost::asio::async_read(s, boost::asio::buffer(query),
+                                                                     boost::asio::as_tuple(boost::cobalt::use_op));
+      if (ec)
+        continue;
+
+      auto r = respond(query, true);
+      len = {static_cast<unsigned char>(r->size() >> 8), static_cast<unsigned char>(r->size())};
+      std::array<boost::asio::const_buffer, 2u> bufs{boost::asio::buffer(len), boost::asio::buffer(*r)};
+      co_await boost::asio::async_write(s, bufs, boost::asio::as_tuple(boost::cobalt::use_op));
+    }
+  }
+
+  void close()
+  {
+    udp.close();
+    tcp.close();
+  }
+};
+
+}
+
+CO_TEST_CASE(dns_resolver_stub)
+{
+  stub_nameserver ns;
+  auto udp = ns.serve_udp();
+  auto tcp = ns.serve_tcp();
+
+  cobalt::io::dns_resolver::config cfg;
+  cfg.nameservers.push_back(ns.endpoint());
+  cfg.timeout = std::chrono::milliseconds(50);
+  cfg.attempts = 2u;
+  cobalt::io::dns_resolver res{cfg};
+
+  auto eps = co_await res.resolve("a.test", "80");
+  BOOST_REQUIRE(eps.size() == 2u);
+  for (auto & ep : eps)
+    if (ep.protocol() == cobalt::io::ip_v4)
+      BOOST_CHECK(get<cobalt::io::ip_v4>(ep).addr_str() == "127.0.0.2");
+    else
+    {
+      BOOST_CHECK(ep.protocol() == cobalt::io::ip_v6);
+      BOOST_CHECK(get<cobalt::io::ip_v6>(ep).addr()[15] == 2u);
+    }
+  BOOST_CHECK(get<cobalt::io::ip_v4>(eps.back()).port() == 80u);
+
+  // truncated over UDP, so it gets retried over TCP.
+  eps = co_await res.resolve("tc.test", "80");
+  BOOST_REQUIRE(eps.size() == 1u);
+  BOOST_CHECK(get<cobalt::io::ip_v4>(eps.front()).addr_str() == "127.0.0.3");
+
+  auto [ec, nx] = co_await boost::cobalt::as_tuple(res.resolve("nx.test", "80"));
+  BOOST_CHECK(ec == boost::asio::error::host_not_found);
+  BOOST_CHECK(nx.empty());
+
+  // both questions of the first attempt get dropped, the second one gets answered.
+  eps = co_await res.resolve("slow.test", "80");
+  BOOST_CHECK(eps.size() == 2u);
+  BOOST_CHECK(ns.dropped == 2u);
+
+  auto pre = std::chrono::steady_clock::now();
+  std::tie(ec, nx) = co_await boost::cobalt::as_tuple(res.resolve("dead.test", "80"));
+  BOOST_CHECK(ec == boost::asio::error::timed_out);
+  BOOST_CHECK((std::chrono::steady_clock::now() - pre) >= std::chrono::milliseconds(100));
+
+  ns.close();
+  co_await udp;
+  co_await tcp;
+}
@@ -7,7 +7,14 @@
 
 #include "test.hpp"
 
+#include <boost/asio/io_context.hpp>
+
+#include <cobalt/io/periodic_timer.hpp>
 #include <cobalt/io/sleep.hpp>
+#include <cobalt/io/steady_timer.hpp>
+#include <cobalt/io/system_timer.hpp>
+
+#include <optional>
 
 BOOST_AUTO_TEST_SUITE(sleep_);
 
@@ -22,5 +29,108 @@ CO_TEST_CASE(sleep_duration)
   BOOST_CHECK((post - pre) >= std::chrono::milliseconds(50));
 }
 
+CO_TEST_CASE(timer_wheel)
+{
+  auto & wheel = cobalt::io::timer_wheel::get();
+  auto pre = std::chrono::steady_clock::now();
+  cobalt::io::steady_timer tim{std::chrono::milliseconds(20), wheel};
+  BOOST_CHECK(!tim.expired());
+  co_await tim.wait();
+  BOOST_CHECK((std::chrono::steady_clock::now() - pre) >= std::chrono::milliseconds(20));
+  BOOST_CHECK(tim.expired());
+  BOOST_CHECK(wheel.size() == 0u);
+}
+
+CO_TEST_CASE(timer_wheel_coarse)
+{
+  auto & wheel = cobalt::io::timer_wheel::get();
+  wheel.set_coarse(true);
+  BOOST_CHECK(wheel.now() <= std::chrono::steady_clock::now());
+
+  // the coarse clock lags, but a relative expiry still counts from the precise one.
+  auto pre = std::chrono::steady_clock::now();
+  cobalt::io::steady_timer tim{std::chrono::milliseconds(20), wheel};
+  BOOST_CHECK(tim.expiry() >= pre + std::chrono::milliseconds(20));
+  co_await tim.wait();
+  BOOST_CHECK((std::chrono::steady_clock::now() - pre) >= std::chrono::milliseconds(20));
+
+  pre = std::chrono::steady_clock::now();
+  tim.reset(std::chrono::milliseconds(10));
+  BOOST_CHECK(tim.expiry() >= pre + std::chrono::milliseconds(10));
+  co_await tim.wait();
+  BOOST_CHECK((std::chrono::steady_clock::now() - pre) >= std::chrono::milliseconds(10));
+  wheel.set_coarse(false);
+}
+
+CO_TEST_CASE(timer_slack)
+{
+  cobalt::io::steady_timer a, b;
+  a.set_slack(std::chrono::milliseconds(10));
+  b.set_slack(std::chrono::milliseconds(10));
+
+  const auto pre = std::chrono::steady_clock::now();
+  a.reset(pre + std::chrono::milliseconds(20));
+  b.reset(pre + std::chrono::milliseconds(25));
+  // never early, at most slack late.
+  BOOST_CHECK(a.expiry() >= pre + std::chrono::milliseconds(20));
+  BOOST_CHECK(a.expiry() <= pre + std::chrono::milliseconds(30));
+  BOOST_CHECK(b.expiry() >= pre + std::chrono::milliseconds(25));
+  BOOST_CHECK(b.expiry() <= pre + std::chrono::milliseconds(35));
+  // a 10ms window always holds a multiple of 2^23ns, which is what expiries get aligned to.
+  const auto align = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(1 << 23));
+  BOOST_CHECK(a.expiry().time_since_epoch() % align == std::chrono::steady_clock::duration::zero());
+  BOOST_CHECK(b.expiry().time_since_epoch() % align == std::chrono::steady_clock::duration::zero());
+
+  co_await a.wait();
+  BOOST_CHECK(std::chrono::steady_clock::now() >= pre + std::chrono::milliseconds(20));
+
+  // no slack keeps the expiry as is.
+  cobalt::io::steady_timer c;
+  c.reset(pre + std::chrono::milliseconds(7));
+  BOOST_CHECK(c.expiry() == pre + std::chrono::milliseconds(7));
+}
+
+BOOST_AUTO_TEST_CASE(timer_wheel_per_context)
+{
+  std::optional<boost::asio::io_context> a{std::in_place}, b{std::in_place};
+  // one made by use_service has an executor too.
+  auto & wa = boost::asio::use_service<cobalt::io::timer_wheel>(*a);
+  BOOST_CHECK(wa.get_executor() == boost::cobalt::executor(a->get_executor()));
+  BOOST_CHECK(&cobalt::io::timer_wheel::get(a->get_executor()) == &wa);
+
+  auto & wb = cobalt::io::timer_wheel::get(b->get_executor());
+  BOOST_CHECK(&wb != &wa);
+  BOOST_CHECK(&cobalt::io::timer_wheel::get(a->get_executor()) == &wa);
+
+  // the cached lookup must not survive the context.
+  b.reset();
+  b.emplace();
+  auto & wc = cobalt::io::timer_wheel::get(b->get_executor());
+  BOOST_CHECK(wc.get_executor() == boost::cobalt::executor(b->get_executor()));
+  BOOST_CHECK(&wc == &boost::asio::use_service<cobalt::io::timer_wheel>(*b));
+}
+
+CO_TEST_CASE(system_timerfd)
+{
+  auto pre = std::chrono::system_clock::now();
+  cobalt::io::system_timer tim{cobalt::io::system_timer::use_timerfd, pre + std::chrono::milliseconds(20)};
+  BOOST_CHECK(!tim.expired());
+  co_await tim.wait();
+  BOOST_CHECK(std::chrono::system_clock::now() >= pre + std::chrono::milliseconds(20));
+}
+
+CO_TEST_CASE(periodic)
+{
+  auto pre = std::chrono::steady_clock::now();
+  cobalt::io::periodic_timer tim{pre + std::chrono::milliseconds(10), std::chrono::milliseconds(10)};
+  BOOST_CHECK(co_await tim.tick() == 0u);
+  BOOST_CHECK(co_await tim.tick() == 0u);
+  BOOST_CHECK((std::chrono::steady_clock::now() - pre) >= std::chrono::milliseconds(20));
+  BOOST_CHECK(tim.next() == pre + std::chrono::milliseconds(30));
+
+  co_await cobalt::io::sleep(pre + std::chrono::milliseconds(55));
+  BOOST_CHECK(co_await tim.tick() == 2u);
+  BOOST_CHECK(tim.next() == pre + std::chrono::milliseconds(60));
+}
 
 BOOST_AUTO_TEST_SUITE_END();
\ No newline at end of file
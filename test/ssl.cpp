@@ -0,0 +1,392 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "test.hpp"
+
+#include <boost/asio/thread_pool.hpp>
+#include <boost/cobalt/as_tuple.hpp>
+#include <boost/cobalt/promise.hpp>
+
+#include <cobalt/io/read.hpp>
+#include <cobalt/io/sleep.hpp>
+#include <cobalt/io/ssl.hpp>
+#include <cobalt/io/ssl_session_cache.hpp>
+#include <cobalt/io/stream_socket.hpp>
+#include <cobalt/io/write.hpp>
+
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include <array>
+#include <ctime>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+
+using namespace cobalt::io;
+
+namespace
+{
+
+// a server context with a self-signed certificate for localhost.
+net::ssl::context make_server_context()
+{
+  net::ssl::context c{net::ssl::context::tlsv13_server};
+  auto key = EVP_EC_gen("P-256");
+  auto x = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(x), 1);
+  X509_gmtime_adj(X509_getm_notBefore(x), 0);
+  X509_gmtime_adj(X509_getm_notAfter(x), 60 * 60);
+  X509_set_pubkey(x, key);
+  auto name = X509_get_subject_name(x);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+  X509_set_issuer_name(x, name);
+  X509_sign(x, key, EVP_sha256());
+  SSL_CTX_use_certificate(c.native_handle(), x);
+  SSL_CTX_use_PrivateKey(c.native_handle(), key);
+  X509_free(x);
+  EVP_PKEY_free(key);
+  return c;
+}
+
+net::ssl::context & server_context()
+{
+  static net::ssl::context ctx = make_server_context();
+  return ctx;
+}
+
+boost::cobalt::promise<void> handshake(ssl_stream & s, ssl_stream::handshake_type ht)
+{
+  co_await s.handshake(ht);
+}
+
+// the lengths of the TLS records the peer sent, read off the socket underneath `s`
+// until they carry `plain` bytes of application data.
+boost::cobalt::promise<std::vector<std::size_t>> record_sizes(ssl_stream & s, std::size_t plain)
+{
+  // TLS 1.3 adds the inner content type & a 16 byte AEAD tag to every record.
+  constexpr std::size_t overhead = 17u;
+  std::vector<std::size_t> sizes;
+  std::vector<unsigned char> raw;
+  std::size_t parsed = 0u;
+  while (plain > 0u)
+  {
+    co_await s.wait(socket::wait_type::wait_read);
+    std::array<unsigned char, 4096> chunk;
+    const auto n = ::recv(s.socket::native_handle(), chunk.data(), chunk.size(), MSG_DONTWAIT);
+    BOOST_REQUIRE(n > 0);
+    raw.insert(raw.end(), chunk.begin(), chunk.begin() + n);
+
+    while (raw.size() - parsed >= 5u)
+    {
+      BOOST_CHECK(raw[parsed] == 0x17); // application data
+      const std::size_t len = (std::size_t(raw[parsed + 3u]) << 8) | raw[parsed + 4u];
+      if (raw.size() - parsed < 5u + len)
+        break;
+      sizes.push_back(len);
+      plain -= (std::min)(plain, len - overhead);
+      parsed += 5u + len;
+    }
+  }
+  co_return sizes;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(ssl_);
+
+CO_TEST_CASE(gathered_write)
+{
+  auto [a, b] = make_pair(local_stream).value();
+  ssl_stream client{std::move(a)};
+  ssl_stream server{server_context(), std::move(b)};
+
+  auto hs = handshake(server, ssl_stream::server);
+  co_await client.handshake(ssl_stream::client);
+  co_await hs;
+
+  const std::array<const_buffer, 3u> bufs{buffer("abc", 3u), buffer("defg", 4u), buffer("hi", 2u)};
+  BOOST_CHECK(co_await client.write_some(std::span<const const_buffer>(bufs)) == 9u);
+
+  // one record, instead of one per buffer.
+  const auto sizes = co_await record_sizes(server, 9u);
+  BOOST_REQUIRE(sizes.size() == 1u);
+  BOOST_CHECK(sizes.front() == 9u + 17u);
+}
+
+CO_TEST_CASE(record_size_ramp)
+{
+  auto [a, b] = make_pair(local_stream).value();
+  ssl_stream client{std::move(a)};
+  ssl_stream server{server_context(), std::move(b)};
+
+  auto hs = handshake(server, ssl_stream::server);
+  co_await client.handshake(ssl_stream::client);
+  co_await hs;
+
+  client.enable_dynamic_record_sizing(2000u, std::chrono::milliseconds(50));
+  const std::string data(4000u, 'r');
+  const auto big = buffer(data.data(), data.size());
+
+  // small records until the warm up is done, then full ones.
+  BOOST_CHECK(co_await client.write_some(big) == ssl_stream::small_record_size);
+  BOOST_CHECK(co_await client.write_some(big) == ssl_stream::small_record_size);
+  BOOST_CHECK(co_await client.write_some(big) == data.size());
+
+  // idle for longer than the threshold, so it starts small again.
+  co_await sleep(std::chrono::milliseconds(60));
+  BOOST_CHECK(co_await client.write_some(big) == ssl_stream::small_record_size);
+
+  const auto sizes = co_await record_sizes(server, 3u * ssl_stream::small_record_size + data.size());
+  const std::vector<std::size_t> expected{ssl_stream::small_record_size + 17u, ssl_stream::small_record_size + 17u,
+                                          data.size() + 17u, ssl_stream::small_record_size + 17u};
+  BOOST_CHECK(sizes == expected);
+}
+
+CO_TEST_CASE(ktls_fallback)
+{
+  // a unix socket has no TCP_ULP, so the stream has to keep encrypting with OpenSSL.
+  auto [a, b] = make_pair(local_stream).value();
+  net::ssl::context ctx{net::ssl::context::tlsv13_client};
+  static int logged;
+  logged = 0;
+  SSL_CTX_set_keylog_callback(ctx.native_handle(), +[](const SSL *, const char *) {logged++;});
+
+  ssl_stream client{ctx, std::move(a)};
+  ssl_stream server{server_context(), std::move(b)};
+  auto r = client.enable_ktls();
+  if (!r)
+  {
+    BOOST_CHECK(r.error() == boost::asio::error::operation_not_supported);
+    co_return;
+  }
+
+  auto hs = handshake(server, ssl_stream::server);
+  co_await client.handshake(ssl_stream::client);
+  co_await hs;
+  BOOST_CHECK(client.upgraded());
+  BOOST_CHECK(!client.ktls_active());
+  // the callback that was installed before still gets called.
+  BOOST_CHECK(logged > 0);
+
+  BOOST_CHECK(co_await client.write_some(buffer("ping", 4u)) == 4u);
+  std::array<char, 4> buf;
+  BOOST_CHECK(co_await read(server, buffer(buf)) == 4u);
+  BOOST_CHECK(std::string_view(buf.data(), buf.size()) == "ping");
+}
+
+CO_TEST_CASE(offload_handshake)
+{
+  auto [a, b] = make_pair(local_stream).value();
+  auto ctx = make_server_context();
+  static std::thread::id crypto_thread;
+  crypto_thread = {};
+  SSL_CTX_set_keylog_callback(ctx.native_handle(), +[](const SSL *, const char *) {crypto_thread = std::this_thread::get_id();});
+
+  boost::asio::thread_pool pool{1u};
+  ssl_stream client{std::move(a)};
+  ssl_stream server{ctx, std::move(b)};
+  server.offload_handshake(pool.get_executor());
+
+  const auto self = std::this_thread::get_id();
+  auto hs = handshake(client, ssl_stream::client);
+  co_await server.handshake(ssl_stream::server);
+  // the crypto ran on the pool, but the coroutine resumes on its own executor.
+  BOOST_CHECK(std::this_thread::get_id() == self);
+  BOOST_CHECK(crypto_thread != std::thread::id{});
+  BOOST_CHECK(crypto_thread != self);
+  co_await hs;
+
+  BOOST_CHECK(co_await client.write_some(buffer("ping", 4u)) == 4u);
+  std::array<char, 4> buf;
+  BOOST_CHECK(co_await read(server, buffer(buf)) == 4u);
+  BOOST_CHECK(std::string_view(buf.data(), buf.size()) == "ping");
+  pool.join();
+}
+
+CO_TEST_CASE(detect_plain)
+{
+  auto [a, b] = make_pair(local_stream).value();
+  ssl_stream server{server_context(), std::move(b)};
+
+  BOOST_CHECK(co_await write(a, buffer("GET /", 5u)) == 5u);
+  BOOST_CHECK(!co_await server.detect_and_handshake());
+  BOOST_CHECK(server.hybrid_mode());
+  BOOST_CHECK(!server.upgraded());
+
+  // the peeked byte is still there.
+  std::array<char, 5> buf;
+  BOOST_CHECK(co_await read(server, buffer(buf)) == 5u);
+  BOOST_CHECK(std::string_view(buf.data(), buf.size()) == "GET /");
+}
+
+CO_TEST_CASE(detect_tls)
+{
+  auto [a, b] = make_pair(local_stream).value();
+  ssl_stream client{std::move(a)};
+  ssl_stream server{server_context(), std::move(b)};
+
+  // the ClientHello is what gets peeked, so the handshake only completes if it wasn't consumed.
+  auto hs = handshake(client, ssl_stream::client);
+  BOOST_CHECK(co_await server.detect_and_handshake());
+  BOOST_CHECK(server.upgraded());
+  co_await hs;
+
+  BOOST_CHECK(co_await client.write_some(buffer("ping", 4u)) == 4u);
+  std::array<char, 4> buf;
+  BOOST_CHECK(co_await read(server, buffer(buf)) == 4u);
+  BOOST_CHECK(std::string_view(buf.data(), buf.size()) == "ping");
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+BOOST_AUTO_TEST_SUITE(ssl_session_cache_);
+
+namespace
+{
+
+SSL_SESSION * make_session(std::string_view id, std::time_t created = std::time(nullptr), long timeout = 300)
+{
+  auto s = SSL_SESSION_new();
+  SSL_SESSION_set1_id(s, reinterpret_cast<const unsigned char*>(id.data()), static_cast<unsigned int>(id.size()));
+  SSL_SESSION_set_time(s, created);
+  SSL_SESSION_set_timeout(s, timeout);
+  return s;
+}
+
+bool contains(ssl_session_cache & cache, std::string_view key)
+{
+  auto s = cache.find(key);
+  SSL_SESSION_free(s);
+  return s != nullptr;
+}
+
+// connects with a session from client_cache & returns if it got resumed.
+boost::cobalt::promise<bool> connect(net::ssl::context & server_ctx, net::ssl::context & client_ctx,
+                                     ssl_session_cache & client_cache)
+{
+  auto [a, b] = make_pair(local_stream).value();
+  ssl_stream client{client_ctx, std::move(a)};
+  ssl_stream server{server_ctx, std::move(b)};
+  client.use_session_cache(client_cache, "localhost:443");
+
+  auto hs = handshake(server, ssl_stream::server);
+  co_await client.handshake(ssl_stream::client);
+  co_await hs;
+
+  // TLS 1.3 tickets come after the handshake, so the client needs to read to get them.
+  co_await write(server, buffer("x", 1u));
+  char c;
+  co_await read(client, buffer(&c, 1u));
+  co_return SSL_session_reused(client.native_handle()) == 1;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(lru)
+{
+  ssl_session_cache cache{2u, 1u};
+  for (auto k : {"a", "b"})
+  {
+    auto s = make_session(k);
+    BOOST_CHECK(cache.insert(k, s));
+    SSL_SESSION_free(s);
+  }
+  BOOST_CHECK(contains(cache, "a")); // a is used more recently than b now
+
+  auto s = make_session("c");
+  cache.insert("c", s);
+  SSL_SESSION_free(s);
+  BOOST_CHECK(cache.size() == 2u);
+  BOOST_CHECK(contains(cache, "a"));
+  BOOST_CHECK(!contains(cache, "b"));
+  BOOST_CHECK(contains(cache, "c"));
+
+  // every shard has its own capacity.
+  ssl_session_cache sharded{4u, 2u};
+  for (auto k : {"0", "1", "2", "3", "4", "5", "6", "7"})
+  {
+    auto s = make_session(k);
+    sharded.insert(k, s);
+    SSL_SESSION_free(s);
+  }
+  BOOST_CHECK(sharded.size() == 4u);
+}
+
+BOOST_AUTO_TEST_CASE(expiry)
+{
+  ssl_session_cache cache;
+  auto s = make_session("old", std::time(nullptr) - 100, 10);
+  BOOST_CHECK(cache.insert("old", s));
+  SSL_SESSION_free(s);
+  BOOST_CHECK(cache.size() == 1u);
+
+  BOOST_CHECK(cache.find("old") == nullptr);
+  BOOST_CHECK(cache.size() == 0u);
+
+  // a session without id or ticket can't be resumed.
+  s = SSL_SESSION_new();
+  BOOST_CHECK(!cache.insert("empty", s));
+  SSL_SESSION_free(s);
+}
+
+CO_TEST_CASE(resumption)
+{
+  ssl_session_cache server_cache, client_cache;
+  auto server_ctx = make_server_context();
+  server_cache.attach(server_ctx);
+  net::ssl::context client_ctx{net::ssl::context::tlsv13_client};
+  client_cache.attach(client_ctx);
+
+  BOOST_CHECK(!co_await connect(server_ctx, client_ctx, client_cache));
+  BOOST_CHECK(client_cache.size() == 1u);
+  BOOST_CHECK(co_await connect(server_ctx, client_ctx, client_cache));
+  // the used ticket got replaced by a fresh one.
+  BOOST_CHECK(client_cache.size() == 1u);
+}
+
+CO_TEST_CASE(ticket_rotation)
+{
+  ssl_session_cache server_cache, client_cache;
+  auto server_ctx = make_server_context();
+  server_cache.attach(server_ctx);
+  net::ssl::context client_ctx{net::ssl::context::tlsv13_client};
+  client_cache.attach(client_ctx);
+
+  BOOST_CHECK(!co_await connect(server_ctx, client_ctx, client_cache));
+  // the previous key is still accepted & the ticket renewed with the current one.
+  server_cache.rotate_ticket_keys();
+  BOOST_CHECK(co_await connect(server_ctx, client_ctx, client_cache));
+  server_cache.rotate_ticket_keys();
+  BOOST_CHECK(co_await connect(server_ctx, client_ctx, client_cache));
+
+  // two rotations without a renewal retire the key.
+  server_cache.rotate_ticket_keys();
+  server_cache.rotate_ticket_keys();
+  BOOST_CHECK(!co_await connect(server_ctx, client_ctx, client_cache));
+}
+
+CO_TEST_CASE(outlived)
+{
+  auto server_ctx = make_server_context();
+  net::ssl::context client_ctx{net::ssl::context::tlsv13_client};
+  {
+    ssl_session_cache server_cache, client_cache;
+    server_cache.attach(server_ctx);
+    client_cache.attach(client_ctx);
+    BOOST_CHECK(!co_await connect(server_ctx, client_ctx, client_cache));
+  }
+  // both contexts got detached, so they just don't resume.
+  ssl_session_cache client_cache;
+  client_cache.attach(client_ctx);
+  BOOST_CHECK(!co_await connect(server_ctx, client_ctx, client_cache));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "test.hpp"
+
+#include <boost/cobalt/as_tuple.hpp>
+#include <boost/cobalt/promise.hpp>
+
+#include <cobalt/io/acceptor.hpp>
+#include <cobalt/io/deadline.hpp>
+#include <cobalt/io/read.hpp>
+#include <cobalt/io/stream_socket.hpp>
+
+BOOST_AUTO_TEST_SUITE(stream_socket_);
+
+using namespace cobalt::io;
+
+CO_TEST_CASE(cork)
+{
+  auto [w, r] = make_pair(local_stream).value();
+  w.cork();
+  BOOST_CHECK(w.corked());
+
+  BOOST_CHECK(co_await w.write_some(buffer("foo", 3)) == 3u);
+  BOOST_CHECK(co_await w.write_some(buffer("bar", 3)) == 3u);
+  // nothing got suspended yet, so nothing got written either.
+  BOOST_CHECK(r.bytes_readable().value() == 0u);
+
+  std::array<char, 6> buf;
+  BOOST_CHECK(co_await read(r, buffer(buf)) == 6u);
+  BOOST_CHECK(std::string_view(buf.data(), buf.size()) == "foobar");
+
+  BOOST_CHECK(co_await w.write_some(buffer("xyz", 3)) == 3u);
+  co_await w.uncork();
+  BOOST_CHECK(!w.corked());
+  BOOST_CHECK(r.bytes_readable().value() == 3u);
+}
+
+static boost::cobalt::promise<std::size_t> write_some(stream_socket & s, std::string_view msg)
+{
+  co_return co_await s.write_some(buffer(msg.data(), msg.size()));
+}
+
+CO_TEST_CASE(cork_concurrent)
+{
+  auto [w, r] = make_pair(local_stream).value();
+  w.cork(4u);
+
+  BOOST_CHECK(co_await w.write_some(buffer("foo", 3)) == 3u);
+  // neither fits, so the first writes with the queue & the second has to wait for it.
+  auto first  = write_some(w, "bar");
+  auto second = write_some(w, "baz");
+  BOOST_CHECK(co_await first  == 3u);
+  BOOST_CHECK(co_await second == 3u);
+  co_await w.uncork();
+
+  std::array<char, 9> buf;
+  BOOST_CHECK(co_await read(r, buffer(buf)) == 9u);
+  BOOST_CHECK(std::string_view(buf.data(), buf.size()) == "foobarbaz");
+}
+
+CO_TEST_CASE(deadline)
+{
+  auto [w, r] = make_pair(local_stream).value();
+  std::array<char, 3> buf;
+
+  auto [ec, n] = co_await boost::cobalt::as_tuple(with_deadline(r.read_some(buffer(buf)), std::chrono::milliseconds(10)));
+  BOOST_CHECK(ec == boost::asio::error::timed_out);
+  BOOST_CHECK(n == 0u);
+
+  BOOST_CHECK(co_await w.write_some(buffer("foo", 3)) == 3u);
+  BOOST_CHECK(co_await with_deadline(r.read_some(buffer(buf)), std::chrono::seconds(10)) == 3u);
+  BOOST_CHECK(cobalt::io::timer_wheel::get().size() == 0u);
+}
+
+CO_TEST_CASE(happy_eyeballs)
+{
+  acceptor acc{endpoint{tcp_v4, "127.0.0.1", 0u}};
+  const auto port = get<tcp_v4>(acc.local_endpoint()).port();
+
+  // nothing listens on ::1, so the v4 attempt wins, either when the first fails or after the delay.
+  stream_socket cl, srv;
+  auto ep = co_await cl.connect(endpoint_sequence{endpoint{tcp_v6, "::1", port}, endpoint{tcp_v4, "127.0.0.1", port}},
+                                socket::happy_eyeballs{std::chrono::milliseconds(10)});
+  BOOST_CHECK(ep.protocol() == tcp_v4);
+  BOOST_CHECK(get<tcp_v4>(ep).port() == port);
+
+  co_await acc.accept(srv);
+  BOOST_CHECK(co_await cl.write_some(buffer("foo", 3)) == 3u);
+  std::array<char, 3> buf;
+  BOOST_CHECK(co_await read(srv, buffer(buf)) == 3u);
+  BOOST_CHECK(std::string_view(buf.data(), buf.size()) == "foo");
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,94 @@
+//
+// Copyright (c) 2024 Klemens Morgenstern (klemens.morgenstern@gmx.net)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "test.hpp"
+
+#include <boost/cobalt/as_tuple.hpp>
+#include <boost/cobalt/promise.hpp>
+
+#include <cobalt/io/read.hpp>
+#include <cobalt/io/sleep.hpp>
+#include <cobalt/io/stream_socket.hpp>
+#include <cobalt/io/write_queue.hpp>
+
+BOOST_AUTO_TEST_SUITE(write_queue_);
+
+using namespace cobalt::io;
+
+static boost::cobalt::promise<std::tuple<error_code, std::size_t>> run(write_queue & q)
+{
+  co_return co_await boost::cobalt::as_tuple(q.run());
+}
+
+static boost::cobalt::promise<std::tuple<error_code, std::size_t>> produce(write_queue & q, std::string_view msg)
+{
+  co_return co_await boost::cobalt::as_tuple(q.write_some(buffer(msg.data(), msg.size())));
+}
+
+CO_TEST_CASE(order)
+{
+  auto [w, r] = make_pair(local_stream).value();
+  write_queue q{w.write_some({})};
+  auto writer = run(q);
+
+  BOOST_CHECK(co_await q.write_some(buffer("foo", 3)) == 3u);
+  BOOST_CHECK(co_await q.write_some(buffer("bar", 3)) == 3u);
+  q.close();
+  BOOST_CHECK(std::get<1>(co_await writer) == 6u);
+
+  std::array<char, 6> buf;
+  BOOST_CHECK(co_await read(r, buffer(buf)) == 6u);
+  BOOST_CHECK(std::string_view(buf.data(), buf.size()) == "foobar");
+}
+
+CO_TEST_CASE(back_pressure)
+{
+  auto [w, r] = make_pair(local_stream).value();
+  write_queue q{w.write_some({}), 4u};
+
+  BOOST_CHECK(co_await q.write_some(buffer("foo", 3)) == 3u);
+  auto waiting = produce(q, "bar");
+  BOOST_CHECK(!waiting.ready());
+  BOOST_CHECK(q.queued() == 3u);
+
+  auto writer = run(q);
+  BOOST_CHECK(co_await waiting == std::make_tuple(error_code{}, std::size_t(3u)));
+  q.close();
+  BOOST_CHECK(std::get<1>(co_await writer) == 6u);
+
+  std::array<char, 6> buf;
+  BOOST_CHECK(co_await read(r, buffer(buf)) == 6u);
+  BOOST_CHECK(std::string_view(buf.data(), buf.size()) == "foobar");
+}
+
+CO_TEST_CASE(cancel)
+{
+  auto [w, r] = make_pair(local_stream).value();
+  write_queue q{w.write_some({}), 4u};
+
+  BOOST_CHECK(co_await q.write_some(buffer("foo", 3)) == 3u);
+  auto waiting = produce(q, "bar");
+  waiting.cancel();
+  BOOST_CHECK(std::get<0>(co_await waiting) == boost::asio::error::operation_aborted);
+  BOOST_CHECK(q.queued() == 3u);
+
+  auto writer = run(q);
+  BOOST_CHECK(co_await q.write_some(buffer("baz", 3)) == 3u);
+  std::array<char, 6> buf;
+  BOOST_CHECK(co_await read(r, buffer(buf)) == 6u);
+  BOOST_CHECK(std::string_view(buf.data(), buf.size()) == "foobaz");
+
+  // idle now, so cancelling stops it without closing the queue.
+  co_await sleep(std::chrono::milliseconds(1));
+  writer.cancel();
+  auto [ec, n] = co_await writer;
+  BOOST_CHECK(ec == boost::asio::error::operation_aborted);
+  BOOST_CHECK(n == 6u);
+  BOOST_CHECK(q.queued() == 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END();